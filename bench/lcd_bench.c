@@ -0,0 +1,660 @@
+// Benchmark for the collectors, the frame renderer and the daemon tick.
+//
+// Each case is timed per call (CLOCK_MONOTONIC, p50/p99 over -n calls), its
+// heap allocations are counted by wrapping malloc & co. below, and its
+// syscalls are counted by running a batch of calls in a ptrace'd child.
+// Results go out as JSON; with -b they are compared against a baseline
+// written earlier (bench/baseline.json) and the exit status says whether
+// anything regressed.
+//
+// -f runs against a small fixture /proc and /sys (private mount namespace)
+// so syscall and allocation counts don't depend on the host; without it the
+// real ones are used. The interface cache always talks to the real kernel
+// over rtnetlink.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mount.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include "lcd_render.h"
+#include "lcd_state.h"
+#include "metrics.h"
+#include "collector.h"
+#include "fmt.h"
+#include "../driver/plcm_ioctl.h"
+
+#define BENCH_ITERATIONS    2000
+#define BENCH_TRACED_CALLS  50      // calls per case under ptrace
+#define BENCH_WARMUP        20
+#define BENCH_JSON_VERSION  1
+
+// Regression thresholds for -b
+#define DEFAULT_LATENCY_TOLERANCE 1.5   // p99 may grow by this factor...
+#define LATENCY_SLACK_NS          2000  // ...plus this, for sub-µs cases
+#define COUNT_SLACK               0.05  // syscalls/allocs per call
+
+// ---- allocation counter ----
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread unsigned long alloc_count;  // this thread only, not the workers
+
+void *malloc(size_t size) {
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+// ---- panel stand-in ----
+
+// The tick writes to /dev/null instead of /dev/plcm_drv. Its ioctls still
+// go to the kernel (and fail there), so they cost and count like the real
+// ones, but report success so the renderer keeps sending spans.
+static int sink_fd = -1;
+
+int ioctl(int fd, unsigned long request, ...) {
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+
+    long ret = syscall(SYS_ioctl, fd, request, arg);
+    if (fd == sink_fd) {
+        return request == PLCM_IOCTL_GET_KEYPAD ? 0xAF : 0;  // keypad idle
+    }
+    return (int)ret;
+}
+
+// ---- cases ----
+
+static lcd_render_t render;
+static lcd_state_t state;
+static lcd_state_shm_t state_shm;
+static char line1[41], line2[41];
+
+static void case_meminfo(void) {
+    get_mem_usage();
+}
+
+static void case_loadavg(void) {
+    get_load_avg();
+}
+
+static void case_thermal(void) {
+    get_cpu_temp();
+}
+
+static void case_fans(void) {
+    get_fan_rpm();
+}
+
+static void case_disk(void) {
+    get_disk_usage();
+}
+
+// {disk}: the next of the fullest filesystems, from the worker's snapshot
+static void case_disks(void) {
+    char buf[32];
+    static int n;
+    get_fullest_disk(n++, 3, buf, sizeof(buf));
+}
+
+static void case_procs(void) {
+    get_process_count();
+}
+
+static void case_net_rates(void) {
+    char buf[32];
+    get_network_rates(buf, sizeof(buf));
+}
+
+static void case_interfaces(void) {
+    ip_info_t ips[LCD_MAX_IPS];
+    collect_ip_addresses(ips, LCD_MAX_IPS);
+}
+
+// The values of one frame through fmt.h...
+static void case_units(void) {
+    static const unsigned char ip[4] = { 192, 0, 2, 10 };
+    char buf[6][FMT_MAX];
+    fmt_bytes(buf[0], 1572864);
+    fmt_bytes(buf[1], 12345);
+    fmt_uptime(buf[2], 4 * 86400 + 7 * 3600);
+    fmt_hundredths(buf[3], 73);
+    fmt_pct(buf[4], 87);
+    fmt_ipv4(buf[5], ip);
+}
+
+// ... and through libc, as composing did before
+static void case_units_libc(void) {
+    static const unsigned char ip[4] = { 192, 0, 2, 10 };
+    char buf[6][FMT_MAX];
+    snprintf(buf[0], sizeof(buf[0]), "%.1fM", 1572864 / (1024.0 * 1024.0));
+    snprintf(buf[1], sizeof(buf[1]), "%ldK", 12345L / 1024);
+    snprintf(buf[2], sizeof(buf[2]), "%dd%dh", 4, 7);
+    snprintf(buf[3], sizeof(buf[3]), "%ld.%02ld", 73L / 100, 73L % 100);
+    snprintf(buf[4], sizeof(buf[4]), "%d%%", 87);
+    inet_ntop(AF_INET, ip, buf[5], sizeof(buf[5]));
+}
+
+static int eval_fixed(screen_var_t var, char *buf, size_t buflen, void *ctx) {
+    (void)ctx;
+    fmt_str(buf, buflen, var == SCREEN_VAR_UPTIME ? "123d23h" : "100");
+    return 1;
+}
+
+// Laying out a screen that overflows, so a field is dropped
+static void case_layout(void) {
+    char out[SCREEN_COLS];
+    screen_render(render.cfg, 1, eval_fixed, NULL, out);
+}
+
+// Every metric on the screen due, as right after a screen change
+static void case_frame(void) {
+    metrics_invalidate();
+    lcd_render_compose(&render, 0, 0, line1, line2);
+}
+
+// Steady state: metrics within their refresh interval come from the cache
+static void case_frame_cached(void) {
+    lcd_render_compose(&render, 0, 0, line1, line2);
+}
+
+// What lcd_button_daemon does per keypad poll plus repaint: read the keypad,
+// compose, send what changed, publish the state
+static void case_daemon_tick(void) {
+    ioctl(sink_fd, PLCM_IOCTL_GET_KEYPAD, 0);
+    lcd_render_frame(&render, sink_fd, 0, 0);
+    memcpy(state.line1, render.frame[0], sizeof(state.line1));
+    memcpy(state.line2, render.frame[1], sizeof(state.line2));
+    state.frames = render.frames;
+    lcd_state_publish(&state_shm, &state);
+}
+
+// Between frames the collector workers finish what a frame requested; a
+// case that requests samples lets them, untimed, instead of having them
+// preempt its next call (on one CPU that is all the p99 would show)
+static void settle_workers(void) {
+    collector_settle(1000);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    void (*idle)(void);          // untimed after each call, NULL for none
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    { "meminfo",      case_meminfo,       NULL },
+    { "loadavg",      case_loadavg,       NULL },
+    { "thermal",      case_thermal,       NULL },
+    { "fans",         case_fans,          NULL },
+    { "disk",         case_disk,          NULL },
+    { "disks",        case_disks,         NULL },
+    { "procs",        case_procs,         NULL },
+    { "net_rates",    case_net_rates,     NULL },
+    { "interfaces",   case_interfaces,    NULL },
+    { "units",        case_units,         NULL },
+    { "units_libc",   case_units_libc,    NULL },
+    { "layout",       case_layout,        NULL },
+    { "frame",        case_frame,         settle_workers },
+    { "frame_cached", case_frame_cached,  settle_workers },
+    { "daemon_tick",  case_daemon_tick,   settle_workers },
+};
+#define NCASES ((int)(sizeof(cases) / sizeof(cases[0])))
+
+typedef struct {
+    char name[32];
+    long long p50_ns;
+    long long p99_ns;
+    double syscalls;             // per call, -1 if ptrace isn't available
+    double allocs;               // per call
+} bench_result_t;
+
+// ---- measurement ----
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Syscalls per call: a forked child stops itself, then the parent single
+// steps it from syscall to syscall over `calls` runs of the case
+static double count_syscalls(const bench_case_t *c, int calls) {
+    int status, in_call = 0, sig = 0;
+    long entries = 0;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) {
+            _exit(2);
+        }
+        raise(SIGSTOP);
+        for (int i = 0; i < calls; i++) {
+            c->run();
+        }
+        _exit(0);
+    }
+
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status) ||
+        ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL)) != 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+    for (;;) {
+        if (ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)sig) != 0 || waitpid(pid, &status, 0) != pid) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            return -1;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            break;
+        }
+        sig = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            entries += !in_call;
+            in_call = !in_call;
+        } else {
+            sig = WSTOPSIG(status);  // pass real signals on
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return (double)(entries - 1) / calls;  // minus the child's exit_group
+}
+
+static void run_case(const bench_case_t *c, int iterations, int traced_calls, bench_result_t *res) {
+    static long long samples[100000];
+
+    if (iterations > (int)(sizeof(samples) / sizeof(samples[0]))) {
+        iterations = sizeof(samples) / sizeof(samples[0]);
+    }
+
+    // Open handles, fill caches, fault in pages
+    for (int i = 0; i < BENCH_WARMUP; i++) {
+        c->run();
+    }
+
+    unsigned long allocs = alloc_count;
+    for (int i = 0; i < iterations; i++) {
+        long long t0 = now_ns();
+        c->run();
+        samples[i] = now_ns() - t0;
+        if (c->idle) {
+            c->idle();
+        }
+    }
+    allocs = alloc_count - allocs;
+    qsort(samples, iterations, sizeof(samples[0]), cmp_ll);
+
+    snprintf(res->name, sizeof(res->name), "%s", c->name);
+    res->p50_ns = samples[iterations / 2];
+    res->p99_ns = samples[(iterations * 99) / 100];
+    res->allocs = (double)allocs / iterations;
+    res->syscalls = count_syscalls(c, traced_calls);
+}
+
+// ---- fixture ----
+
+static char fixture_dir[64];
+
+static int write_file(const char *rel, const char *fmt, ...) {
+    char path[384];
+    va_list ap;
+
+    snprintf(path, sizeof(path), "%s/%s", fixture_dir, rel);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+    va_start(ap, fmt);
+    vfprintf(f, fmt, ap);
+    va_end(ap);
+    return fclose(f);
+}
+
+static int make_dir(const char *rel) {
+    char path[384];
+    snprintf(path, sizeof(path), "%s/%s", fixture_dir, rel);
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+static int make_link(const char *target, const char *rel) {
+    char path[384];
+    snprintf(path, sizeof(path), "%s/%s", fixture_dir, rel);
+    return symlink(target, path);
+}
+
+static int write_map(const char *path, const char *text) {
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int ok = write(fd, text, strlen(text)) == (ssize_t)strlen(text);
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+// Enter a private mount namespace (through a user namespace when not root)
+static int enter_mount_ns(void) {
+    char map[64];
+    uid_t uid = getuid();
+    gid_t gid = getgid();
+
+    if (unshare(CLONE_NEWNS) == 0) {
+        return 0;
+    }
+    if (errno != EPERM || unshare(CLONE_NEWUSER | CLONE_NEWNS) != 0) {
+        return -1;
+    }
+    snprintf(map, sizeof(map), "0 %u 1\n", (unsigned)uid);
+    if (write_map("/proc/self/uid_map", map) != 0) {
+        return -1;
+    }
+    write_map("/proc/self/setgroups", "deny");
+    snprintf(map, sizeof(map), "0 %u 1\n", (unsigned)gid);
+    return write_map("/proc/self/gid_map", map);
+}
+
+// A machine with 4 cores' worth of processes, one NIC, one thermal zone,
+// coretemp plus nct6775 hwmon devices (one package sensor, two fans) and a
+// mount table with the root among pseudo filesystems, on a tmpfs only this
+// process sees
+static int setup_fixture(void) {
+    static const char *dirs[] = {
+        "proc", "sys", "sys/class", "sys/class/thermal", "sys/class/thermal/thermal_zone0",
+        "sys/class/net", "sys/devices", "sys/devices/pci0000:00", "sys/devices/pci0000:00/0000:00:1f.6",
+        "sys/devices/pci0000:00/0000:00:1f.6/net", "sys/devices/pci0000:00/0000:00:1f.6/net/eth0",
+        "sys/devices/pci0000:00/0000:00:1f.6/net/eth0/statistics",
+        "sys/devices/virtual", "sys/devices/virtual/net", "sys/devices/virtual/net/lo",
+        "sys/class/hwmon", "sys/class/hwmon/hwmon0", "sys/class/hwmon/hwmon1",
+        NULL
+    };
+    static const char *eth0 = "sys/devices/pci0000:00/0000:00:1f.6/net/eth0";
+    char path[256];
+
+    snprintf(fixture_dir, sizeof(fixture_dir), "/tmp/lcd_bench.XXXXXX");
+    if (!mkdtemp(fixture_dir)) {
+        return -1;
+    }
+    if (enter_mount_ns() != 0 ||
+        mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0 ||
+        mount("lcd_bench", fixture_dir, "tmpfs", 0, "mode=0755") != 0) {
+        rmdir(fixture_dir);
+        return -1;
+    }
+
+    int err = 0;
+    for (int i = 0; dirs[i]; i++) {
+        err |= make_dir(dirs[i]);
+    }
+    for (int pid = 1; pid <= 180; pid++) {
+        snprintf(path, sizeof(path), "proc/%d", pid * 7);
+        err |= make_dir(path);
+    }
+    err |= make_dir("proc/self");
+    err |= write_file("proc/self/mountinfo",
+                      "21 27 0:20 / /sys rw,nosuid,nodev,noexec,relatime shared:7 - sysfs sysfs rw\n"
+                      "22 27 0:21 / /proc rw,nosuid,nodev,noexec,relatime shared:12 - proc proc rw\n"
+                      "27 1 8:2 / / rw,relatime shared:1 - ext4 /dev/sda2 rw,errors=remount-ro\n"
+                      "28 27 0:26 / /run rw,nosuid,nodev,noexec,relatime shared:5 - tmpfs tmpfs rw\n"
+                      "29 27 7:0 / /snap/core/1 ro,nodev,relatime shared:9 - squashfs /dev/loop0 ro\n");
+    err |= make_dir("proc/sys");
+    err |= make_dir("proc/net");
+    err |= write_file("proc/loadavg", "0.52 0.58 0.59 2/245 12345\n");
+    err |= write_file("proc/meminfo",
+                      "MemTotal:        8041032 kB\n"
+                      "MemFree:         3264080 kB\n"
+                      "MemAvailable:    6123412 kB\n"
+                      "Buffers:          201144 kB\n"
+                      "Cached:          2521876 kB\n"
+                      "SwapCached:            0 kB\n"
+                      "Active:          2342304 kB\n"
+                      "Inactive:        1871500 kB\n"
+                      "SwapTotal:       2097148 kB\n"
+                      "SwapFree:        2097148 kB\n"
+                      "Dirty:               120 kB\n");
+    err |= write_file("sys/class/thermal/thermal_zone0/temp", "41000\n");
+    err |= write_file("sys/class/hwmon/hwmon0/name", "coretemp\n");
+    err |= write_file("sys/class/hwmon/hwmon0/temp1_input", "45000\n");
+    err |= write_file("sys/class/hwmon/hwmon0/temp1_label", "Package id 0\n");
+    err |= write_file("sys/class/hwmon/hwmon0/temp2_input", "43000\n");
+    err |= write_file("sys/class/hwmon/hwmon0/temp2_label", "Core 0\n");
+    err |= write_file("sys/class/hwmon/hwmon1/name", "nct6775\n");
+    err |= write_file("sys/class/hwmon/hwmon1/fan1_input", "1850\n");
+    err |= write_file("sys/class/hwmon/hwmon1/fan2_input", "0\n");
+
+    snprintf(path, sizeof(path), "%s/operstate", eth0);
+    err |= write_file(path, "up\n");
+    static const char *counters[] = { "rx_bytes", "tx_bytes", "rx_packets", "tx_packets" };
+    for (int i = 0; i < 4; i++) {
+        snprintf(path, sizeof(path), "%s/statistics/%s", eth0, counters[i]);
+        err |= write_file(path, "%d\n", 1000000 * (i + 1));
+    }
+    snprintf(path, sizeof(path), "%s/device", eth0);
+    err |= make_link("../../../0000:00:1f.6", path);
+    err |= write_file("sys/devices/virtual/net/lo/operstate", "unknown\n");
+    err |= make_link("../../devices/pci0000:00/0000:00:1f.6/net/eth0", "sys/class/net/eth0");
+    err |= make_link("../../devices/virtual/net/lo", "sys/class/net/lo");
+    if (err) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/proc", fixture_dir);
+    if (mount(path, "/proc", NULL, MS_BIND, NULL) != 0) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/sys", fixture_dir);
+    return mount(path, "/sys", NULL, MS_BIND, NULL);
+}
+
+static void remove_fixture(void) {
+    // The mounts vanish with the namespace; only the empty mountpoint is
+    // visible outside
+    umount2("/proc", MNT_DETACH);
+    umount2("/sys", MNT_DETACH);
+    umount2(fixture_dir, MNT_DETACH);
+    rmdir(fixture_dir);
+}
+
+// ---- JSON ----
+
+static void write_json(FILE *f, const char *source, int iterations, const bench_result_t *res, int n) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"version\": %d,\n", BENCH_JSON_VERSION);
+    fprintf(f, "  \"source\": \"%s\",\n", source);
+    fprintf(f, "  \"iterations\": %d,\n", iterations);
+    fprintf(f, "  \"cases\": [\n");
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "    {\"name\": \"%s\", \"p50_ns\": %lld, \"p99_ns\": %lld, \"syscalls\": %.2f, \"allocs\": %.2f}%s\n",
+                res[i].name, res[i].p50_ns, res[i].p99_ns, res[i].syscalls, res[i].allocs,
+                i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+// Reads back what write_json() wrote: one case per line
+static int read_baseline(const char *path, char *source, size_t source_len, bench_result_t *res, int max) {
+    char line[512];
+    int n = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    source[0] = '\0';
+    while (fgets(line, sizeof(line), f) && n < max) {
+        char *p;
+        if ((p = strstr(line, "\"source\": \"")) != NULL) {
+            p += strlen("\"source\": \"");
+            snprintf(source, source_len, "%.*s", (int)strcspn(p, "\""), p);
+        } else if ((p = strstr(line, "{\"name\"")) != NULL &&
+                   sscanf(p, "{\"name\": \"%31[^\"]\", \"p50_ns\": %lld, \"p99_ns\": %lld, \"syscalls\": %lf, \"allocs\": %lf",
+                          res[n].name, &res[n].p50_ns, &res[n].p99_ns, &res[n].syscalls, &res[n].allocs) == 5) {
+            n++;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+// Print a comparison table to stderr; returns the number of regressions
+static int compare(const bench_result_t *res, int n, const bench_result_t *base, int nbase, double tolerance) {
+    int regressions = 0;
+
+    fprintf(stderr, "%-14s %10s %10s %8s %8s %8s %8s\n",
+            "case", "p99 ns", "base", "sys", "base", "alloc", "base");
+    for (int i = 0; i < n; i++) {
+        const bench_result_t *b = NULL;
+        for (int j = 0; j < nbase; j++) {
+            if (strcmp(base[j].name, res[i].name) == 0) {
+                b = &base[j];
+            }
+        }
+        if (!b) {
+            fprintf(stderr, "%-14s %10lld %10s (not in baseline)\n", res[i].name, res[i].p99_ns, "-");
+            continue;
+        }
+
+        const char *why = NULL;
+        if (res[i].p99_ns > b->p99_ns * tolerance + LATENCY_SLACK_NS) {
+            why = "latency";
+        } else if (res[i].syscalls >= 0 && b->syscalls >= 0 && res[i].syscalls > b->syscalls + COUNT_SLACK) {
+            why = "syscalls";
+        } else if (res[i].allocs > b->allocs + COUNT_SLACK) {
+            why = "allocations";
+        }
+        fprintf(stderr, "%-14s %10lld %10lld %8.2f %8.2f %8.2f %8.2f%s%s\n",
+                res[i].name, res[i].p99_ns, b->p99_ns, res[i].syscalls, b->syscalls,
+                res[i].allocs, b->allocs, why ? "  REGRESSED: " : "", why ? why : "");
+        regressions += why != NULL;
+    }
+    return regressions;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-f] [-n iterations] [-o out.json] [-b baseline.json] [-t tolerance]\n"
+            "  -f  run against a fixture /proc and /sys instead of the real ones\n"
+            "  -n  timed calls per case (default %d)\n"
+            "  -o  write JSON results here (default stdout)\n"
+            "  -b  compare against a baseline; exit 1 on regression\n"
+            "  -t  allowed p99 growth factor (default %.1f)\n",
+            prog, BENCH_ITERATIONS, DEFAULT_LATENCY_TOLERANCE);
+}
+
+int main(int argc, char *argv[]) {
+    static bench_result_t results[NCASES], baseline[NCASES * 2];
+    const char *out_path = NULL, *baseline_path = NULL;
+    double tolerance = DEFAULT_LATENCY_TOLERANCE;
+    int iterations = BENCH_ITERATIONS;
+    int use_fixture = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "fn:o:b:t:h")) != -1) {
+        switch (opt) {
+            case 'f': use_fixture = 1; break;
+            case 'n': iterations = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'b': baseline_path = optarg; break;
+            case 't': tolerance = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (iterations < 100) {
+        fprintf(stderr, "Need at least 100 iterations for a p99\n");
+        return 2;
+    }
+
+    if (use_fixture && setup_fixture() != 0) {
+        fprintf(stderr, "Cannot set up the fixture tree: %s\n", strerror(errno));
+        return 2;
+    }
+
+    sink_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    lcd_render_init(&render);
+    state_shm.magic = LCD_STATE_MAGIC;
+
+    for (int i = 0; i < NCASES; i++) {
+        run_case(&cases[i], iterations, BENCH_TRACED_CALLS, &results[i]);
+        if (results[i].syscalls < 0) {
+            fprintf(stderr, "%s: ptrace unavailable, syscalls not counted\n", cases[i].name);
+        }
+    }
+
+    if (use_fixture) {
+        remove_fixture();
+    }
+
+    FILE *out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+        return 2;
+    }
+    write_json(out, use_fixture ? "fixture" : "live", iterations, results, NCASES);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    if (!baseline_path) {
+        return 0;
+    }
+
+    char source[16];
+    int nbase = read_baseline(baseline_path, source, sizeof(source), baseline, NCASES * 2);
+    if (nbase <= 0) {
+        fprintf(stderr, "%s: no baseline results\n", baseline_path);
+        return 2;
+    }
+    if (strcmp(source, use_fixture ? "fixture" : "live") != 0) {
+        fprintf(stderr, "Warning: baseline was taken on '%s', this run on '%s'\n",
+                source, use_fixture ? "fixture" : "live");
+    }
+    int regressions = compare(results, NCASES, baseline, nbase, tolerance);
+    if (regressions) {
+        fprintf(stderr, "%d case(s) regressed against %s\n", regressions, baseline_path);
+        return 1;
+    }
+    fprintf(stderr, "No regressions against %s\n", baseline_path);
+    return 0;
+}
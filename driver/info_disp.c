@@ -59,11 +59,11 @@ int main(int argc, char *argv[])
     Keypad_Value = ioctl(devfd, PLCM_IOCTL_GET_KEYPAD, 0);
 	if(Pre_Value != Keypad_Value)
 		{
-			detect_press=(Keypad_Value & 0x40);
-			detect_dir=(Keypad_Value & 0x28);
-			 if(detect_press == 0x40){
+			detect_press=(Keypad_Value & PLCM_KEYPAD_PRESSED);
+			detect_dir=(Keypad_Value & PLCM_KEYPAD_DIR_MASK);
+			 if(detect_press == PLCM_KEYPAD_PRESSED){
 				switch(detect_dir){
-			    	case 0x20: // left
+			    	case PLCM_KEYPAD_DIR_LEFT:
 						btn2_state = 0;
 						btn3_state = 0;
 						btn4_state = 0;
@@ -76,7 +76,7 @@ int main(int argc, char *argv[])
 						}
 						
 					break;
-			    	case 0x00: // up
+			    	case PLCM_KEYPAD_DIR_UP:
 						btn1_state = 0;
 						btn3_state = 0;
 						btn4_state = 0;
@@ -88,7 +88,7 @@ int main(int argc, char *argv[])
 							btn2_state = 1;
 						} 
 					break;
-			    	case 0x08: // down
+			    	case PLCM_KEYPAD_DIR_DOWN:
 						btn1_state = 0;
 						btn2_state = 0;
 						btn4_state = 0;
@@ -100,7 +100,7 @@ int main(int argc, char *argv[])
 							btn3_state = 1;
 						} 
 					break;
-					case 0x28: // right
+					case PLCM_KEYPAD_DIR_RIGHT:
 						btn1_state = 0;
 						btn2_state = 0;
 						btn3_state = 0;
@@ -12,6 +12,15 @@
 #include <linux/uaccess.h>
 #include <linux/ioport.h>  // For request_region/release_region
 #include <linux/device.h>  // For device_create/class_create
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/moduleparam.h>
+#include <linux/leds.h>
+#include <linux/workqueue.h>
 #include "plcm_ioctl.h"
 
 #if defined(OLDKERNEL)
@@ -58,7 +67,12 @@ static struct device *plcm_device = NULL;
  */
 static void LCM_Init(void);
 static void LCM_Command(unsigned char RS, unsigned char RWn, unsigned char CMD, unsigned int uDelay, unsigned char *Ret);
-static void LCM_Backlight(void);
+static void LCM_Backlight(unsigned char On, int Nowait);
+static void plcm_port_unlock(void);
+static unsigned char LCM_Keypad(int Scan);
+static void LCM_Data_Burst(const unsigned char *Data, unsigned int Len, unsigned int uDelay);
+static int LCM_Adopt(void);
+static void LCM_Load_CGRAM(void);
 
 /*
  * Device Depend Definition
@@ -76,6 +90,7 @@ static unsigned int  StatusPort = 0;
 static unsigned int  ControlPort = 0;
 static int port_reserved = 0; // Track if we successfully reserved the port
 static unsigned char Backlight = 0; // Backlight ON
+static int Backlight_Pending = 0; // Backlight changed while the port was busy
 static unsigned char Cur_Line = 1; // Current Line#
 static unsigned char Cur_EntryMode = 0x04; // Current Entry Mode Set CMD
 static unsigned char Cur_Display = 0x08; // Current Display On/Off Ctrl
@@ -83,6 +98,143 @@ static unsigned char Cur_Shift = 0x10; // Current Cursor/Dsiplay Shift Ctrl
 
 static unsigned int row = 0; // count row
 
+/*
+ * Adopt an already initialised controller on load instead of clearing it,
+ * so a module reload leaves the panel contents in place.
+ */
+static bool adopt = false;
+module_param(adopt, bool, 0444);
+MODULE_PARM_DESC(adopt, "Keep the current panel contents on load (skip Display Clear)");
+
+/*
+ * While the device is open the keypad is also scanned every keypad_scan_ms
+ * and the first new press seen is latched.  PLCM_IOCTL_GET_KEYPAD returns a
+ * latched press once if the button is already released again, so a tap
+ * between two reads of a slowly polling reader is not lost.  0 turns the
+ * scan off (reads then see only the level at the time of the read).
+ */
+static unsigned int keypad_scan_ms = 20;
+module_param(keypad_scan_ms, uint, 0444);
+MODULE_PARM_DESC(keypad_scan_ms, "Latch key presses between reads, scan period in ms (0 = off)");
+
+/*
+ * Shadow of DDRAM for both lines, kept in step by plcm_write(), the span
+ * ioctl and Display Clear, and filled from the panel on adoption.  While
+ * Shadow_Valid is set plcm_read() is served from it without a bus cycle;
+ * it is cleared by commands whose effect on DDRAM we don't track
+ * (INPUT_CHAR, decrementing entry mode).
+ */
+static unsigned char DDRAM_Shadow[2][40];
+static int Shadow_Valid = 0;
+
+/*
+ * Locking
+ *
+ * plcm_lcd_lock serialises HD44780 command sequences (ioctls, and each
+ * PLCM_WRITE_CHUNK slice of a write).  plcm_port_lock only covers the
+ * control-port bus cycle inside LCM_Command(), during which CR[5] is
+ * cleared and the status port does not carry keypad data.  Keypad reads
+ * take plcm_port_lock alone, so they wait for at most one strobe and never
+ * behind a whole line write or a clear.
+ */
+static DEFINE_MUTEX(plcm_lcd_lock);
+static DEFINE_SPINLOCK(plcm_port_lock);
+
+/*
+ * Bumped by every command sequence that may move the DDRAM address
+ * counter.  plcm_write() re-issues its address between chunks only when
+ * someone else got in.
+ */
+static unsigned long Addr_Seq = 0;
+
+#define PLCM_WRITE_CHUNK	4	// chars per plcm_lcd_lock hold in plcm_write
+#define PLCM_SETUP_MAX_US	46	// RS/RW setup before E, as used by DISPLAY_CAREFUL_MODE
+#define PLCM_SLEEP_MIN_US	1000	// settle times from here on sleep instead of spin
+
+/*
+ * Keypad read latency histogram (debugfs: plcm_drv/keypad_latency)
+ * Bucket n counts reads that took [2^n, 2^(n+1)) ns; updated under
+ * plcm_port_lock.
+ */
+#define PLCM_LAT_BUCKETS 24
+static unsigned long Keypad_Lat_Hist[PLCM_LAT_BUCKETS];
+static unsigned long Keypad_Lat_Count = 0;
+static u64 Keypad_Lat_Max = 0;
+
+/*
+ * Keypad latch (see keypad_scan_ms), under plcm_port_lock.  Keypad_Latch
+ * is a status byte with a press not yet returned by a read, 0 for none;
+ * Keypad_Scan_Last the previous scan, so a held button latches only once.
+ */
+static unsigned char Keypad_Latch = 0;
+static unsigned char Keypad_Scan_Last = 0;
+static void plcm_keypad_scan(struct work_struct *work);
+static DECLARE_DELAYED_WORK(plcm_keypad_work, plcm_keypad_scan);
+
+static const unsigned char Blank_Line[20] = { [0 ... 19] = ' ' };
+static const unsigned char Cursor_Glyph[8] = { 0x1F, 0x11, 0x15, 0x15, 0x15, 0x11, 0x1F, 0x00 };
+
+/*
+ * Add character in CGRAM as below, to all 8 slots.
+ * 11111
+ * 10001
+ * 10101
+ * 10101
+ * 10101
+ * 10001
+ * 11111
+ * 00000
+ * CGRAM address auto-increments, so one Set CGRAM Address covers all 64
+ * rows.
+ */
+static void LCM_Load_CGRAM(void)
+{
+	unsigned int i;
+
+	LCM_Command(0, 0, 0x40, 300, NULL); // Set CGRAM Address
+	for(i = 0; i < 8; i++)
+	{
+		LCM_Data_Burst(Cursor_Glyph, PLCM_WRITE_CHUNK, 46);
+		LCM_Data_Burst(Cursor_Glyph + PLCM_WRITE_CHUNK, 8 - PLCM_WRITE_CHUNK, 46);
+	}
+}
+
+/*
+ * Probe for a controller that is already up and pull both lines of DDRAM
+ * into the shadow.  Returns 0 if the panel can be adopted.
+ */
+static int LCM_Adopt(void)
+{
+	unsigned char Data;
+	int line, i, floating = 1;
+
+	LCM_Command(0, 1, 0, 46, &Data); // Read Busy Flag / Address
+	if(Data & 0x80)
+	{
+		printk(KERN_INFO "plcm_drv: controller busy, not adopting\n");
+		return -EBUSY;
+	}
+	for(line = 0; line < 2; line++)
+	{
+		LCM_Command(0, 0, line ? 0xC0 : 0x80, 300, NULL); // Set DDRAM Address
+		for(i = 0; i < 40; i++)
+		{
+			LCM_Command(1, 1, 0x00, 46, &Data); // Read Data
+			DDRAM_Shadow[line][i] = Data;
+			if(Data != 0xFF)
+				floating = 0;
+		}
+	}
+	if(floating)
+	{
+		/* Nothing drives the bus: no controller, or not in 8-bit mode */
+		printk(KERN_INFO "plcm_drv: no readable DDRAM, not adopting\n");
+		return -ENODEV;
+	}
+	Shadow_Valid = 1;
+	return 0;
+}
+
 static void LCM_Init(void)
 {
 	unsigned int i = 0;
@@ -125,49 +277,36 @@ static void LCM_Init(void)
 		LCM_Command(0, 0, 0x38,  300, NULL);
 		LCM_Command(0, 0, 0x38,  300, NULL);
 		LCM_Command(0, 0, 0x38,  300, NULL);
+		if(adopt && LCM_Adopt() == 0)
+		{
+			/*
+			 * DDRAM is already in the shadow.  Function Set above and
+			 * the CGRAM load below don't touch it; turn the display on
+			 * with the cursor off, as the daemon leaves it.
+			 */
+			LCM_Command(0, 0, 0x0C,  300, NULL); Cur_Display=0x0C;// Display On/OFF
+			LCM_Command(0, 0, 0x06,  300, NULL); Cur_EntryMode=0x06;// Entry Mode Set
+			LCM_Load_CGRAM();
+			LCM_Command(0, 0, 0x80,  300, NULL); // Set DDRAM Address
+			printk(KERN_INFO "plcm_drv: adopted panel contents\n");
+			return;
+		}
 		LCM_Command(0, 0, 0x0F,  300, NULL); Cur_Display=0x0F;// Display On/OFF
 		LCM_Command(0, 0, 0x01, 3000, NULL); // Display Clear
-		LCM_Command(0, 0, 0x06,  300, NULL); // Entry Mode Set
+		LCM_Command(0, 0, 0x06,  300, NULL); Cur_EntryMode=0x06;// Entry Mode Set
 		LCM_Command(0, 0, 0x80,  300, NULL); // Set DDRAM Address	
-		for(i = 0; i < 20; i++) // Range: 0x00~0x27
+		for(i = 0; i < 20; i += PLCM_WRITE_CHUNK) // Range: 0x00~0x27
 		{
-			LCM_Command(1, 0, ' ', 300, NULL); // Write Data
-			//count++;
+			LCM_Data_Burst(Blank_Line + i, PLCM_WRITE_CHUNK, 46); // Write Data
 		}
 		LCM_Command(0, 0, 0xC0, 300, NULL); // Set DDRAM Address
-		for(i = 0; i < 20; i++) // Range: 0x40~0x67
-		{
-			LCM_Command(1, 0, ' ', 300, NULL); // Write Data
-			//count++;
-		}
-		// Add character in CGRAM as below.
-		// 11111 
-		// 10001
-		// 10101
-		// 10101
-		// 10101
-		// 10001
-		// 11111
-		// 00000
-		for(i = 0; i < 8; i++)
+		for(i = 0; i < 20; i += PLCM_WRITE_CHUNK) // Range: 0x40~0x67
 		{
-			LCM_Command(0, 0, 0x40+i*8+0, 300, NULL);
-			LCM_Command(1, 0, 0x1F, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+1, 300, NULL);
-			LCM_Command(1, 0, 0x11, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+2, 300, NULL);
-			LCM_Command(1, 0, 0x15, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+3, 300, NULL);
-			LCM_Command(1, 0, 0x15, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+4, 300, NULL);
-			LCM_Command(1, 0, 0x15, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+5, 300, NULL);
-			LCM_Command(1, 0, 0x11, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+6, 300, NULL);
-			LCM_Command(1, 0, 0x1F, 300, NULL);
-			LCM_Command(0, 0, 0x40+i*8+7, 300, NULL);
-			LCM_Command(1, 0, 0x00, 300, NULL);
+			LCM_Data_Burst(Blank_Line + i, PLCM_WRITE_CHUNK, 46); // Write Data
 		}
+		memset(DDRAM_Shadow, ' ', sizeof(DDRAM_Shadow));
+		Shadow_Valid = 1;
+		LCM_Load_CGRAM();
 	}
 	return;
 }
@@ -176,12 +315,14 @@ static void LCM_Init(void)
 static void LCM_Command(unsigned char RS, unsigned char RWn, unsigned char CMD, unsigned int uDelay, unsigned char *Ret)
 {
 	unsigned char Ctrl = 0;
+	unsigned int uSetup = min(uDelay, (unsigned int)PLCM_SETUP_MAX_US);
 
-	Ctrl |= Backlight;
 	if(RS == 0)
 	{
 		Ctrl |= 0x08; // RS: Real RS = ~RS
 	}
+	spin_lock(&plcm_port_lock);
+	Ctrl |= Backlight;
 	if(RWn == 1)
 	{
 		Ctrl |= 0x24; // RWn: Read = 1, Write = 0
@@ -189,7 +330,7 @@ static void LCM_Command(unsigned char RS, unsigned char RWn, unsigned char CMD,
 		outb(CMD, DataPort); // LCM Data Write
 	}
 	outb(Ctrl | ENABLE, ControlPort); // Set RS and RWn, E = 0
-	udelay(uDelay);
+	udelay(uSetup);
 	outb(Ctrl & ~ENABLE, ControlPort); // E = 1 
 	udelay(10);
 	if((RWn == 1) && (Ret != NULL))
@@ -198,10 +339,96 @@ static void LCM_Command(unsigned char RS, unsigned char RWn, unsigned char CMD,
 	}
 	/* For IT8xxx support-io, set CR[5] to 1 is requests for keypad function */
 	outb(Ctrl | 0x20 | ENABLE, ControlPort); // E = 0
+	plcm_port_unlock();
+
+	/* Execution time; the keypad is readable again from here on */
+	if(uDelay + 1 >= PLCM_SLEEP_MIN_US)
+		usleep_range(uDelay + 1, uDelay + 1 + uDelay / 8);
+	else
+		udelay(uDelay + 1);
+	return;
+}
+
+/*
+ * Write a run of display data (RS=1) to DDRAM or CGRAM at the current
+ * address.  RS/RW are set once and stay latched, each byte costs one data
+ * write plus one E pulse, and CR[5] (keypad mode) is restored once at the
+ * end of the run.  LCM_Command() needs four port writes and a setup delay
+ * per byte for the same thing.  The status port is not valid as keypad
+ * input while CR[5] is cleared, so plcm_port_lock is held for the whole
+ * run; keep runs to PLCM_WRITE_CHUNK bytes.
+ */
+static void LCM_Data_Burst(const unsigned char *Data, unsigned int Len, unsigned int uDelay)
+{
+	unsigned char Ctrl; // RS = 1, RWn = 0
+	unsigned int i;
+
+	if(Len == 0)
+		return;
+	spin_lock(&plcm_port_lock);
+	Ctrl = Backlight;
+	outb(Ctrl | ENABLE, ControlPort); // Set RS and RWn, E = 0
+	for(i = 0; i < Len; i++)
+	{
+		if(i > 0)
+			udelay(uDelay); // Execution time of the previous byte
+		outb(Data[i], DataPort); // LCM Data Write
+		outb(Ctrl & ~ENABLE, ControlPort); // E = 1
+		udelay(10);
+		outb(Ctrl | ENABLE, ControlPort); // E = 0, latch
+	}
+	/* For IT8xxx support-io, set CR[5] to 1 is requests for keypad function */
+	outb(Ctrl | 0x20 | ENABLE, ControlPort);
+	plcm_port_unlock();
 	udelay(uDelay + 1);
 	return;
 }
 
+/*
+ * Read the keypad status byte.  A scan only latches a new press; a read
+ * (Scan = 0) consumes the latch, returning the latched press instead of
+ * the released state it would otherwise see.
+ */
+static unsigned char LCM_Keypad(int Scan)
+{
+	unsigned char Val;
+	u64 t0, dt;
+	unsigned int b;
+
+	t0 = ktime_get_ns();
+	spin_lock(&plcm_port_lock);
+	Val = inb(StatusPort);
+	dt = ktime_get_ns() - t0;
+	b = dt ? ilog2(dt) : 0;
+	if(b >= PLCM_LAT_BUCKETS)
+		b = PLCM_LAT_BUCKETS - 1;
+	Keypad_Lat_Hist[b]++;
+	Keypad_Lat_Count++;
+	if(dt > Keypad_Lat_Max)
+		Keypad_Lat_Max = dt;
+	if(Scan)
+	{
+		if((Val & PLCM_KEYPAD_PRESSED) && !(Keypad_Scan_Last & PLCM_KEYPAD_PRESSED) && !Keypad_Latch)
+			Keypad_Latch = Val;
+		Keypad_Scan_Last = Val;
+	}
+	else
+	{
+		if(!(Val & PLCM_KEYPAD_PRESSED) && Keypad_Latch)
+			Val = Keypad_Latch;
+		Keypad_Latch = 0;
+	}
+	plcm_port_unlock();
+	return Val;
+}
+
+static void plcm_keypad_scan(struct work_struct *work)
+{
+	LCM_Keypad(1);
+	if(READ_ONCE(Device_Open))
+		schedule_delayed_work(&plcm_keypad_work, msecs_to_jiffies(keypad_scan_ms));
+}
+
 #ifdef DISPLAY_CAREFUL_MODE
 static int check_busy(unsigned char dd_addr)
 {
@@ -230,7 +457,8 @@ static int check_busy(unsigned char dd_addr)
 }
 #endif
 
-static void LCM_Backlight(void)
+/* Write Backlight to control bit 0; called with plcm_port_lock held */
+static void LCM_Apply_Backlight(void)
 {
 	unsigned char Ctrl = inb(ControlPort);
 
@@ -243,9 +471,87 @@ static void LCM_Backlight(void)
 		Ctrl &= ~0x01;
 	}
 	outb(Ctrl, ControlPort);
-	return;
 }
 
+/*
+ * Drop plcm_port_lock, first applying a backlight change that a Nowait
+ * caller left behind while we held it (the strobe we just did wrote the
+ * old bit).  A change recorded after our check is picked up by the
+ * recheck once the lock is free.
+ */
+static void plcm_port_unlock(void)
+{
+	do
+	{
+		if(xchg(&Backlight_Pending, 0))
+			LCM_Apply_Backlight();
+		spin_unlock(&plcm_port_lock);
+		smp_mb();
+	} while(READ_ONCE(Backlight_Pending) && spin_trylock(&plcm_port_lock));
+}
+
+/*
+ * Backlight is only changed under plcm_port_lock so a strobe in progress
+ * can't write the old value back.  LED triggers call in with Nowait set,
+ * possibly from a timer or from panic(), where spinning on a lock that an
+ * interrupted or stopped context holds would hang; if the lock is busy
+ * they record the new state as pending, and whoever holds the lock
+ * applies it on the way out.
+ */
+static void LCM_Backlight(unsigned char On, int Nowait)
+{
+	WRITE_ONCE(Backlight, On ? 0 : 1); // Control bit 0 set = backlight off
+	if(Nowait)
+	{
+		WRITE_ONCE(Backlight_Pending, 1);
+		smp_mb();
+		if(spin_trylock(&plcm_port_lock))
+			plcm_port_unlock();
+		return;
+	}
+	spin_lock(&plcm_port_lock);
+	LCM_Apply_Backlight();
+	plcm_port_unlock();
+}
+
+#if IS_ENABLED(CONFIG_LEDS_CLASS)
+/*
+ * The backlight as an LED class device (/sys/class/leds/plcm::backlight),
+ * so it can be switched with one sysfs write or driven by any LED trigger
+ * (timer, heartbeat, netdev, panic) without holding /dev/plcm_drv open.
+ */
+static void plcm_led_set(struct led_classdev *led_cdev, enum led_brightness value)
+{
+	LCM_Backlight(value != LED_OFF, 1);
+}
+
+/*
+ * LED_RETAIN_AT_SHUTDOWN: unregistering on rmmod leaves the backlight as it
+ * is, like the rest of the panel, for the next load to adopt
+ */
+static struct led_classdev plcm_backlight_led = {
+	.name		= "plcm::backlight",
+	.max_brightness	= 1,
+	.brightness	= 1,
+	.brightness_set	= plcm_led_set,
+	.flags		= LED_RETAIN_AT_SHUTDOWN,
+};
+static int plcm_led_registered = 0;
+
+/*
+ * PLCM_IOCTL_BACKLIGHT is an explicit request, so it ends any trigger
+ * (timer, netdev, ...) that would switch the backlight right back, and goes
+ * through the LED core so a blink stops and sysfs reads what the panel shows
+ */
+static void plcm_led_ioctl(int On)
+{
+#if IS_ENABLED(CONFIG_LEDS_TRIGGERS)
+	led_trigger_remove(&plcm_backlight_led);
+#endif
+	led_set_brightness(&plcm_backlight_led, On);
+}
+#endif
+
 #if 0
 static int plcm_thread(void *s)
 {
@@ -281,6 +587,7 @@ static ssize_t plcm_read(struct file *file, char __user * buffer, size_t length,
 	{
 		return 0;
 	}
+	mutex_lock(&plcm_lcd_lock);
 	if(Cur_Line == 1){
 		dd_addr = 0x80;
 	}else if(Cur_Line == 2){
@@ -288,11 +595,13 @@ static ssize_t plcm_read(struct file *file, char __user * buffer, size_t length,
 	}
 #ifdef DISPLAY_CAREFUL_MODE
         int err_cnt;
+	Addr_Seq++;
 	for(i = 0; i < 40; i++)
 	{
 		err_cnt = 0;
 		while(1){
 			if( err_cnt > 10){
+				mutex_unlock(&plcm_lcd_lock);
 				return -ECOMM;
 			}
 			err_cnt++;
@@ -305,13 +614,25 @@ static ssize_t plcm_read(struct file *file, char __user * buffer, size_t length,
 		put_user(Data, buffer + i); // Copy Data
 	}
 #else
-	LCM_Command(0, 0, dd_addr, 300, NULL);
-	for(i = 0; i < 40; i++)
+	if(Shadow_Valid)
+	{
+		/* DDRAM is known; leave the bus (and the address counter) alone */
+		for(i = 0; i < 40; i++)
+			put_user(DDRAM_Shadow[Cur_Line - 1][i], buffer + i);
+	}
+	else
 	{
-		LCM_Command(1, 1, 0x00, 46, &Data); // Read Data
-		put_user(Data, buffer + i); // Copy Data 
+		Addr_Seq++;
+		LCM_Command(0, 0, dd_addr, 300, NULL);
+		for(i = 0; i < 40; i++)
+		{
+			LCM_Command(1, 1, 0x00, 46, &Data); // Read Data
+			DDRAM_Shadow[Cur_Line - 1][i] = Data;
+			put_user(Data, buffer + i); // Copy Data 
+		}
 	}
 #endif
+	mutex_unlock(&plcm_lcd_lock);
 	Data = 0;
 	put_user(Data, buffer + i); // Copy Data
 	//printk("plcm_drv: Read operation\n");
@@ -325,9 +646,13 @@ static ssize_t plcm_write(struct file *file, const char __user * buffer, size_t
 #endif
 {
 	unsigned char LCM_Message[40], dd_addr=0x80;
-    //    unsigned char Data;
+#ifdef DISPLAY_CAREFUL_MODE
+	unsigned char Data;
+	int err_cnt;
+#else
+	unsigned long my_seq;
+#endif
 	int i = 0;
-    //    int err_cnt;
 
 	if(length > 40)
 	{
@@ -343,18 +668,26 @@ static ssize_t plcm_write(struct file *file, const char __user * buffer, size_t
 		else
 			LCM_Message[i] = ' ';
 	}
+
+	mutex_lock(&plcm_lcd_lock);
 	if(Cur_Line == 1){
 		dd_addr = 0x80;
 	}else if(Cur_Line == 2){
 		dd_addr = 0xC0;
 	}
+	if(Cur_EntryMode & 0x02)
+		memcpy(DDRAM_Shadow[Cur_Line - 1], LCM_Message, 40);
+	else
+		Shadow_Valid = 0;
 #ifdef DISPLAY_CAREFUL_MODE
 	/* Careful mode; Confirm each character was printed correctly */
+	Addr_Seq++;
 	for(i = 0; i < 40; i++)
 	{
 		err_cnt = 0;
 		while(1){
 			if( err_cnt > 10){
+				mutex_unlock(&plcm_lcd_lock);
 				return -ECOMM;
 			}
 			err_cnt++;
@@ -371,23 +704,69 @@ static ssize_t plcm_write(struct file *file, const char __user * buffer, size_t
 			printk("PLCM DR: RAM_Data is Incrroct\n");
 		}
 	}
+	mutex_unlock(&plcm_lcd_lock);
 #else
-	/* Fast mode; print directly without confirm */
+	/*
+	 * Fast mode; print directly without confirm.  The line is sent in
+	 * PLCM_WRITE_CHUNK slices so ioctls from other threads can get in
+	 * between; the address is only re-sent if one of them moved it.
+	 */
 	LCM_Command(0, 0, dd_addr, 300, NULL);
-	for(i = 0; i < 40; i++)
+	my_seq = ++Addr_Seq;
+	for(i = 0; i < 40; i += PLCM_WRITE_CHUNK)
 	{
-		LCM_Command(1, 0, LCM_Message[i], 46, NULL);
+		if(i > 0)
+		{
+			mutex_unlock(&plcm_lcd_lock);
+			cond_resched();
+			mutex_lock(&plcm_lcd_lock);
+			if(Addr_Seq != my_seq)
+			{
+				LCM_Command(0, 0, dd_addr + i, 300, NULL);
+				my_seq = ++Addr_Seq;
+			}
+		}
+		LCM_Data_Burst(LCM_Message + i, min(40 - i, PLCM_WRITE_CHUNK), 46);
 	}
+	mutex_unlock(&plcm_lcd_lock);
 #endif
 
 	return 40;
 }
 
-#if ( LINUX_VERSION_CODE < KERNEL_VERSION(2,6,36) )
-static int plcm_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
-#else
-static long plcm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
-#endif
+/*
+ * Write part of a line without touching the rest of it, for callers that
+ * only send what changed since their last frame.  Called with
+ * plcm_lcd_lock held; the port lock is still dropped every
+ * PLCM_WRITE_CHUNK characters so keypad reads get in between.
+ */
+static long plcm_write_span(const void __user *arg)
+{
+	struct plcm_span span;
+	unsigned char dd_addr;
+	int i;
+
+	if(copy_from_user(&span, arg, sizeof(span)))
+		return -EFAULT;
+	if((span.line != 1 && span.line != 2) || span.col >= 40 ||
+	   span.len == 0 || span.len > 40 - span.col)
+		return -EINVAL;
+	/* Positions only add up with an incrementing address counter */
+	if(!(Cur_EntryMode & 0x02))
+		return -EINVAL;
+
+	dd_addr = (span.line == 1 ? 0x80 : 0xC0) + span.col;
+	LCM_Command(0, 0, dd_addr, 300, NULL);
+	for(i = 0; i < span.len; i += PLCM_WRITE_CHUNK)
+		LCM_Data_Burst(span.data + i, min(span.len - i, PLCM_WRITE_CHUNK), 46);
+	memcpy(DDRAM_Shadow[span.line - 1] + span.col, span.data, span.len);
+	return 0;
+}
+
+/*
+ * Controller commands; called with plcm_lcd_lock held
+ */
+static long plcm_do_ioctl(unsigned int cmd, unsigned long arg)
 {
 	switch(cmd)
 	{
@@ -399,11 +778,12 @@ static long plcm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			if (arg != 0 && arg != 1) {
 				return -EINVAL;
 			}
-			if(arg == 0)
-				Backlight = 1;
-			else if (arg == 1)
-				Backlight = 0;
-			LCM_Backlight();
+#if IS_ENABLED(CONFIG_LEDS_CLASS)
+			if (plcm_led_registered)
+				plcm_led_ioctl(arg);
+#endif
+			/* Applied here too, so it is on the port when we return */
+			LCM_Backlight(arg, 0);
 			break;
 		case PLCM_IOCTL_SET_LINE:
 			if (arg != 1 && arg != 2) {
@@ -422,6 +802,8 @@ static long plcm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		case PLCM_IOCTL_CLEARDISPLAY:
 			LCM_Command(0, 0, 0x01, 1640, NULL);
+			memset(DDRAM_Shadow, ' ', sizeof(DDRAM_Shadow));
+			Shadow_Valid = 1;
 			row = 0;
 			break;
 		case PLCM_IOCTL_RETURNHOME:
@@ -508,9 +890,6 @@ static long plcm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				}
 			}
 			break;
-		case PLCM_IOCTL_GET_KEYPAD:
-			return inb(StatusPort);
-			break;
 		case PLCM_IOCTL_INPUT_CHAR:
 			if (arg > 0xFF) {
 				return -EINVAL;
@@ -524,14 +903,81 @@ static long plcm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				LCM_Command(0, 0, 0xC0+row, 300, NULL);
 			}*/
 			LCM_Command(1, 0, (char)arg,  300, NULL);
+			Shadow_Valid = 0;
 			row ++;
 			break;
+		case PLCM_IOCTL_WRITE_SPAN:
+			return plcm_write_span((const void __user *)arg);
 		default:
 			return -EOPNOTSUPP;
 	}
 	return 0;
 }
 
+#if ( LINUX_VERSION_CODE < KERNEL_VERSION(2,6,36) )
+static int plcm_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
+#else
+static long plcm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+#endif
+{
+	long ret;
+
+	/* Keypad reads never queue behind display traffic */
+	if(cmd == PLCM_IOCTL_GET_KEYPAD)
+		return LCM_Keypad(0);
+
+	mutex_lock(&plcm_lcd_lock);
+	Addr_Seq++;
+	ret = plcm_do_ioctl(cmd, arg);
+	mutex_unlock(&plcm_lcd_lock);
+	return ret;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *plcm_debugfs_dir = NULL;
+
+static int plcm_keypad_latency_show(struct seq_file *m, void *v)
+{
+	unsigned long hist[PLCM_LAT_BUCKETS], count;
+	u64 max;
+	int i;
+
+	spin_lock(&plcm_port_lock);
+	memcpy(hist, Keypad_Lat_Hist, sizeof(hist));
+	count = Keypad_Lat_Count;
+	max = Keypad_Lat_Max;
+	plcm_port_unlock();
+
+	seq_printf(m, "samples %lu\n", count);
+	seq_printf(m, "max_ns %llu\n", (unsigned long long)max);
+	for(i = 0; i < PLCM_LAT_BUCKETS; i++)
+	{
+		if(hist[i] == 0)
+			continue;
+		seq_printf(m, "%10llu-%llu ns: %lu\n",
+			i ? 1ULL << i : 0ULL, (1ULL << (i + 1)) - 1, hist[i]);
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(plcm_keypad_latency);
+
+static void plcm_debugfs_init(void)
+{
+	plcm_debugfs_dir = debugfs_create_dir("plcm_drv", NULL);
+	debugfs_create_file("keypad_latency", 0440, plcm_debugfs_dir, NULL,
+			    &plcm_keypad_latency_fops);
+}
+
+static void plcm_debugfs_exit(void)
+{
+	debugfs_remove_recursive(plcm_debugfs_dir);
+	plcm_debugfs_dir = NULL;
+}
+#else
+static void plcm_debugfs_init(void) { }
+static void plcm_debugfs_exit(void) { }
+#endif
+
 /*
  * This function is called whenever a process attempts to
  * open the device file
@@ -546,6 +992,14 @@ static int plcm_open(struct inode * inode, struct file * file)
 	/* we don't want to talk to two processes at the same time */
 	if(Device_Open) return -EBUSY;
 	Device_Open++;
+	if(keypad_scan_ms)
+	{
+		spin_lock(&plcm_port_lock);
+		Keypad_Latch = 0;
+		Keypad_Scan_Last = 0;
+		plcm_port_unlock();
+		schedule_delayed_work(&plcm_keypad_work, 0);
+	}
 	/* Make sure that the module isn't removed while the file
 	 * is open by incrementing the usage count (the number of
 	 * opened references to the module,if it's zero emmod will
@@ -560,6 +1014,8 @@ static int plcm_open(struct inode * inode, struct file * file)
  */
 static int plcm_release(struct inode * inode, struct file * file)
 {
+	/* stop the keypad scan (it requeues itself) before the next open */
+	cancel_delayed_work_sync(&plcm_keypad_work);
 	/* ready for next caller */
 	Device_Open--;
 	/* Decrement the usage count, otherwise once you opened the file
@@ -687,6 +1143,14 @@ int plcm_init(void)
 	}
 
 	printk(KERN_INFO "plcm_drv: Device created at /dev/plcm_drv\n");
+	plcm_debugfs_init();
+
+#if IS_ENABLED(CONFIG_LEDS_CLASS)
+	if(led_classdev_register(plcm_device, &plcm_backlight_led) == 0)
+		plcm_led_registered = 1;
+	else
+		printk(KERN_WARNING "plcm_drv: backlight LED not registered, ioctl only\n");
+#endif
 
 #if 0
 	kernel_thread(plcm_thread, (void *)"Parallel LCM Thread", 0);
@@ -699,6 +1163,14 @@ int plcm_init(void)
  */
 void plcm_exit(void)
 {
+#if IS_ENABLED(CONFIG_LEDS_CLASS)
+	if (plcm_led_registered) {
+		led_classdev_unregister(&plcm_backlight_led);
+		plcm_led_registered = 0;
+	}
+#endif
+	plcm_debugfs_exit();
+
 	/* Destroy device and class in reverse order of creation */
 	if (plcm_device && !IS_ERR(plcm_device)) {
 		device_destroy(plcm_class, MKDEV(PLCM_MAJOR, 0));
@@ -1,3 +1,6 @@
+#ifndef PLCM_IOCTL_H
+#define PLCM_IOCTL_H
+
 #define PLCM_IOCTL_STOP_THREAD  0x00
 #define PLCM_IOCTL_BACKLIGHT    0x01
 // Arg 1 = On, 0 = Off
@@ -20,5 +23,25 @@
 #define PLCM_IOCTL_SHIFT_RL     0x0B
 //Arg for R/L - Right/Left
 #define PLCM_IOCTL_GET_KEYPAD   0x0C
+//Returns the keypad status byte; idle reads 0xAF
+#define PLCM_KEYPAD_PRESSED     0x40
+#define PLCM_KEYPAD_DIR_MASK    0x28
+//Button codes under PLCM_KEYPAD_DIR_MASK, as read on the NCA-2510A
+#define PLCM_KEYPAD_DIR_UP      0x00
+#define PLCM_KEYPAD_DIR_DOWN    0x08
+#define PLCM_KEYPAD_DIR_RIGHT   0x20
+#define PLCM_KEYPAD_DIR_LEFT    0x28
 //Input char
 #define PLCM_IOCTL_INPUT_CHAR  0x0E
+//Write a span of one line at a column; Arg = (struct plcm_span *)
+//Leaves the rest of the line alone (returns -EOPNOTSUPP on older drivers)
+#define PLCM_IOCTL_WRITE_SPAN  0x0F
+
+struct plcm_span {
+	unsigned char line;	// 1 or 2
+	unsigned char col;	// 0..39
+	unsigned char len;	// 1..40-col
+	unsigned char data[40];
+};
+
+#endif // PLCM_IOCTL_H
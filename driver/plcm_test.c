@@ -86,32 +86,32 @@ int main(int argc, char *argv[])
 					ioctl(devfd, PLCM_IOCTL_CLEARDISPLAY, 0);
 					ioctl(devfd, PLCM_IOCTL_RETURNHOME, 0);
 				}
-				detect_press=(Keypad_Value & 0x40);
-				detect_dir=(Keypad_Value & 0x28);
+				detect_press=(Keypad_Value & PLCM_KEYPAD_PRESSED);
+				detect_dir=(Keypad_Value & PLCM_KEYPAD_DIR_MASK);
 			        switch(detect_dir)
 				{
-					case 0x00:
+					case PLCM_KEYPAD_DIR_UP:
 						snprintf(Keypad_Message, sizeof(Keypad_Message), "Up-");
 						break;
-					case 0x20:
+					case PLCM_KEYPAD_DIR_LEFT:
 						snprintf(Keypad_Message, sizeof(Keypad_Message), "Left-");
 						break;
-					case 0x08:
+					case PLCM_KEYPAD_DIR_RIGHT:
 						snprintf(Keypad_Message, sizeof(Keypad_Message), "Right-");
 						break;
-					case 0x28:
+					case PLCM_KEYPAD_DIR_DOWN:
 						snprintf(Keypad_Message, sizeof(Keypad_Message), "Down-");
 						break;
 				} 	
 				switch(detect_press)
 				{
-					case 0x40:
+					case PLCM_KEYPAD_PRESSED:
 						{
 						size_t len = strlen(Keypad_Message);
 						snprintf(Keypad_Message + len, sizeof(Keypad_Message) - len, "Press     ");
 					}
 						break;
-					case 0x00:
+					case 0: // released
 						{
 						size_t len = strlen(Keypad_Message);
 						snprintf(Keypad_Message + len, sizeof(Keypad_Message) - len, "Release     ");
@@ -226,34 +226,34 @@ int main(int argc, char *argv[])
 		Keypad_Value = ioctl(devfd, PLCM_IOCTL_GET_KEYPAD, 0);
 		if(Pre_Value != Keypad_Value)
 		{
-			detect_press=(Keypad_Value & 0x40);
-			detect_dir=(Keypad_Value & 0x28);
+			detect_press=(Keypad_Value & PLCM_KEYPAD_PRESSED);
+			detect_dir=(Keypad_Value & PLCM_KEYPAD_DIR_MASK);
 			switch(detect_dir){
-			    case 0x00:
+			    case PLCM_KEYPAD_DIR_UP:
 				snprintf(Keypad_Message, sizeof(Keypad_Message), "  Up    ");
 				Counter |= 0x10 | (detect_press>>6);
 				break;
-			    case 0x20:
+			    case PLCM_KEYPAD_DIR_LEFT:
 				snprintf(Keypad_Message, sizeof(Keypad_Message), "  Left  ");
 				Counter |= 0x20 | (detect_press>>5);
 				break;
-			    case 0x08:
+			    case PLCM_KEYPAD_DIR_RIGHT:
 				snprintf(Keypad_Message, sizeof(Keypad_Message), "  Right ");
 				Counter |= 0x40 | (detect_press>>4);
 				break;
-			    case 0x28:
+			    case PLCM_KEYPAD_DIR_DOWN:
 				snprintf(Keypad_Message, sizeof(Keypad_Message), "  Down  ");
 				Counter |= 0x80 | (detect_press>>3);
 				break;
 			}
 			switch(detect_press){
-			    case 0x40:
+			    case PLCM_KEYPAD_PRESSED:
 				{
 				size_t len = strlen(Keypad_Message);
 				snprintf(Keypad_Message + len, sizeof(Keypad_Message) - len, "Press");
 			}
 				break;
-			    case 0x00:
+			    case 0: // released
 				{
 				size_t len = strlen(Keypad_Message);
 				snprintf(Keypad_Message + len, sizeof(Keypad_Message) - len, "Release");
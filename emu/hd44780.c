@@ -0,0 +1,134 @@
+#include <string.h>
+#include "hd44780.h"
+
+void hd44780_reset(hd44780_t *lcd) {
+    memset(lcd, 0, sizeof(*lcd));
+    memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+    lcd->entry = 0x02;
+    lcd->function = 0x10;
+}
+
+// Account one instruction and start its execution time
+static void issue(hd44780_t *lcd, int64_t now_ns, int64_t exec_ns) {
+    if (now_ns < lcd->busy_until_ns) {
+        lcd->overruns++;
+    }
+    lcd->busy_until_ns = now_ns + exec_ns;
+}
+
+// Next/previous DDRAM address in 2-line mode: line 1 is 0x00-0x27,
+// line 2 is 0x40-0x67, and the counter runs from one into the other
+static uint8_t ddram_step(uint8_t ac, int up) {
+    if (up) {
+        if (ac == 0x27) return 0x40;
+        if (ac == 0x67) return 0x00;
+        return (ac + 1) & 0x7F;
+    }
+    if (ac == 0x40) return 0x27;
+    if (ac == 0x00) return 0x67;
+    return (ac - 1) & 0x7F;
+}
+
+static void ac_step(hd44780_t *lcd, int up) {
+    if (lcd->ac_cgram) {
+        lcd->ac = (lcd->ac + (up ? 1 : -1)) & 0x3F;
+    } else {
+        lcd->ac = ddram_step(lcd->ac, up);
+    }
+}
+
+static void shift_display(hd44780_t *lcd, int left) {
+    lcd->shift = (lcd->shift + (left ? 1 : HD44780_LINE_LEN - 1)) % HD44780_LINE_LEN;
+}
+
+void hd44780_command(hd44780_t *lcd, uint8_t cmd, int64_t now_ns) {
+    lcd->commands++;
+
+    if (cmd & 0x80) {                        // Set DDRAM Address
+        issue(lcd, now_ns, HD44780_EXEC_NS);
+        lcd->ac = cmd & 0x7F;
+        lcd->ac_cgram = 0;
+    } else if (cmd & 0x40) {                 // Set CGRAM Address
+        issue(lcd, now_ns, HD44780_EXEC_NS);
+        lcd->ac = cmd & 0x3F;
+        lcd->ac_cgram = 1;
+    } else if (cmd & 0x20) {                 // Function Set
+        issue(lcd, now_ns, HD44780_EXEC_NS);
+        lcd->function = cmd & 0x1C;
+    } else if (cmd & 0x10) {                 // Cursor or Display Shift
+        issue(lcd, now_ns, HD44780_EXEC_NS);
+        if (cmd & 0x08) {
+            shift_display(lcd, !(cmd & 0x04));
+        } else {
+            ac_step(lcd, cmd & 0x04);
+        }
+    } else if (cmd & 0x08) {                 // Display On/Off Control
+        issue(lcd, now_ns, HD44780_EXEC_NS);
+        lcd->display = cmd & 0x07;
+    } else if (cmd & 0x04) {                 // Entry Mode Set
+        issue(lcd, now_ns, HD44780_EXEC_NS);
+        lcd->entry = cmd & 0x03;
+    } else if (cmd & 0x02) {                 // Return Home
+        issue(lcd, now_ns, HD44780_EXEC_CLEAR_NS);
+        lcd->ac = 0;
+        lcd->ac_cgram = 0;
+        lcd->shift = 0;
+    } else if (cmd & 0x01) {                 // Clear Display
+        issue(lcd, now_ns, HD44780_EXEC_CLEAR_NS);
+        memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+        lcd->ac = 0;
+        lcd->ac_cgram = 0;
+        lcd->shift = 0;
+        lcd->entry |= 0x02;
+    }
+}
+
+void hd44780_write(hd44780_t *lcd, uint8_t data, int64_t now_ns) {
+    issue(lcd, now_ns, HD44780_EXEC_DATA_NS);
+    lcd->data_writes++;
+
+    if (lcd->ac_cgram) {
+        lcd->cgram[lcd->ac] = data & 0x1F;
+    } else {
+        lcd->ddram[lcd->ac] = data;
+        if (lcd->entry & 0x01) {
+            shift_display(lcd, lcd->entry & 0x02);
+        }
+    }
+    ac_step(lcd, lcd->entry & 0x02);
+}
+
+uint8_t hd44780_read(hd44780_t *lcd, int64_t now_ns) {
+    issue(lcd, now_ns, HD44780_EXEC_DATA_NS);
+    lcd->data_reads++;
+
+    uint8_t data = lcd->ac_cgram ? lcd->cgram[lcd->ac] : lcd->ddram[lcd->ac];
+    ac_step(lcd, lcd->entry & 0x02);
+    return data;
+}
+
+uint8_t hd44780_status(const hd44780_t *lcd, int64_t now_ns) {
+    return (now_ns < lcd->busy_until_ns ? 0x80 : 0x00) | (lcd->ac & 0x7F);
+}
+
+void hd44780_visible(const hd44780_t *lcd, uint8_t out[2][HD44780_COLS]) {
+    for (int line = 0; line < 2; line++) {
+        for (int col = 0; col < HD44780_COLS; col++) {
+            int addr = (line ? 0x40 : 0x00) + (col + lcd->shift) % HD44780_LINE_LEN;
+            out[line][col] = (lcd->display & 0x04) ? lcd->ddram[addr] : ' ';
+        }
+    }
+}
+
+int hd44780_cursor(const hd44780_t *lcd, int *line, int *col) {
+    if (lcd->ac_cgram || !(lcd->display & 0x04) || (lcd->ac & 0x3F) >= HD44780_LINE_LEN) {
+        return -1;
+    }
+    int pos = ((lcd->ac & 0x3F) - lcd->shift + HD44780_LINE_LEN) % HD44780_LINE_LEN;
+    if (pos >= HD44780_COLS) {
+        return -1;
+    }
+    *line = (lcd->ac & 0x40) ? 1 : 0;
+    *col = pos;
+    return 0;
+}
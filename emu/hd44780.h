@@ -0,0 +1,58 @@
+#ifndef HD44780_H
+#define HD44780_H
+
+#include <stdint.h>
+
+// HD44780 controller model for the plcm_drv emulator.
+//
+// DDRAM and CGRAM are modelled byte for byte, with the address counter
+// behaving as on the real part in 2-line mode (0x27 -> 0x40 -> ... -> 0x67
+// -> 0x00), entry mode increment/decrement and display shift, cursor/display
+// shift commands, and the busy flag. Every instruction is applied at a
+// simulated bus time (ns); an instruction that arrives while the previous
+// one is still executing is counted as an overrun, since real hardware
+// would drop or garble it.
+
+#define HD44780_COLS        20   // visible columns per line
+#define HD44780_LINE_LEN    40   // DDRAM bytes per line
+
+// Execution times at the nominal 270kHz oscillator
+#define HD44780_EXEC_CLEAR_NS   1520000
+#define HD44780_EXEC_NS         37000
+#define HD44780_EXEC_DATA_NS    41000   // 37us + tADD
+
+typedef struct {
+    uint8_t ddram[128];          // indexed by the 7-bit DDRAM address
+    uint8_t cgram[64];
+    uint8_t ac;                  // address counter
+    int ac_cgram;                // 1 after Set CGRAM Address, 0 after Set DDRAM
+    uint8_t entry;               // Entry Mode Set bits: 0x02 I/D, 0x01 S
+    uint8_t display;             // Display Control bits: 0x04 D, 0x02 C, 0x01 B
+    uint8_t function;            // Function Set bits: 0x10 DL, 0x08 N, 0x04 F
+    int shift;                   // display shift, 0..39 (positive = left)
+    int64_t busy_until_ns;
+
+    unsigned long commands;
+    unsigned long data_writes;
+    unsigned long data_reads;
+    unsigned long overruns;      // instructions sent while busy
+} hd44780_t;
+
+// Power-on state: display off, increment, no shift, DDRAM blank
+void hd44780_reset(hd44780_t *lcd);
+
+// RS=0 write / RS=1 write / RS=1 read / RS=0 read (busy flag and AC)
+void hd44780_command(hd44780_t *lcd, uint8_t cmd, int64_t now_ns);
+void hd44780_write(hd44780_t *lcd, uint8_t data, int64_t now_ns);
+uint8_t hd44780_read(hd44780_t *lcd, int64_t now_ns);
+uint8_t hd44780_status(const hd44780_t *lcd, int64_t now_ns);
+
+// Character codes visible in each column (after display shift); all
+// blanks if the display is off
+void hd44780_visible(const hd44780_t *lcd, uint8_t out[2][HD44780_COLS]);
+
+// Column (0..19) and line (0..1) the cursor is in, or -1 if it is not on
+// the visible window
+int hd44780_cursor(const hd44780_t *lcd, int *line, int *col);
+
+#endif // HD44780_H
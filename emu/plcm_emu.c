@@ -0,0 +1,724 @@
+// Userspace stand-in for /dev/plcm_drv, served through CUSE.
+//
+// Implements the plcm_ioctl.h ABI (read, write, all ioctls) with the same
+// semantics as driver/plcm_drv.c, on top of an HD44780 model (hd44780.h).
+// Each controller access is charged the bus time the driver spends on it
+// (setup, strobe and the uDelay it passes), and by default the reply is
+// held back for that long (-t scales this), so clients see the real
+// device's latency.
+// lcd_button_daemon, lcd_vitals, info_disp and plcm_test run against it
+// unmodified on a machine without the parallel port LCD.
+//
+// Speaks the CUSE protocol on /dev/cuse directly (linux/fuse.h); libfuse
+// is not needed. Needs root and the cuse module, and the real plcm_drv
+// must not be loaded (both want /dev/plcm_drv).
+//
+// Keypad presses come from a script (-k) and/or stdin (-i). The panel is
+// printed whenever what it shows changes, and the time from a press to the
+// next visible change (button-to-pixel latency) is reported per press and
+// summarised on exit.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+#include "plcm_ioctl.h"
+#include "hd44780.h"
+
+#define CUSE_DEVICE         "/dev/cuse"
+#define DEFAULT_DEVNAME     "plcm_drv"
+#define EMU_MAX_IO          4096
+#define EMU_REQ_BUF         (EMU_MAX_IO + 65536)
+#define MAX_KEY_EVENTS      1024
+#define DEFAULT_HOLD_MS     250
+#define KEYPAD_IDLE         0xAF
+
+// Same constants as plcm_drv.c
+#define PLCM_WRITE_CHUNK    4
+#define PLCM_SETUP_MAX_US   46
+
+static hd44780_t lcd;
+static int64_t bus_ns;           // simulated bus clock (CLOCK_MONOTONIC based)
+static double time_scale = 1.0;  // how much of the charged bus time to sleep
+
+// Driver state, as in plcm_drv.c
+static int device_open = 0;
+static int backlight_on = 1;
+static unsigned char cur_line = 1;
+static unsigned char cur_entrymode = 0x04;
+static unsigned char cur_display = 0x08;
+static unsigned char cur_shift = 0x10;
+static unsigned int row = 0;
+
+static const unsigned char blank_line[20] = { [0 ... 19] = ' ' };
+static const unsigned char cursor_glyph[8] = { 0x1F, 0x11, 0x15, 0x15, 0x15, 0x11, 0x1F, 0x00 };
+
+// Keypad
+typedef struct {
+    int64_t at_ns;
+    uint8_t code;
+    int hold_ms;
+} key_event_t;
+
+static key_event_t key_script[MAX_KEY_EVENTS];
+static int key_count = 0, key_next = 0;
+static uint8_t key_code = KEYPAD_IDLE;
+static int64_t key_up_ns = 0;
+static uint8_t key_latch = 0;    // press no read has returned yet, 0 if none
+static int64_t press_ns = 0;     // press waiting for a visible change, 0 if none
+
+// Statistics
+static int64_t start_ns;
+static unsigned long requests, opens, busy_opens;
+static unsigned long presses, latencies;
+static int64_t lat_min_ns, lat_max_ns, lat_sum_ns;
+static int64_t bus_busy_ns;      // total bus time charged
+
+static volatile sig_atomic_t stop = 0;
+
+static int64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---- bus level, mirroring LCM_Command() / LCM_Data_Burst() ----
+
+static void lcm_command(int rs, int rw, uint8_t cmd, unsigned int udelay, uint8_t *ret) {
+    unsigned int setup = udelay < PLCM_SETUP_MAX_US ? udelay : PLCM_SETUP_MAX_US;
+    uint8_t val;
+
+    bus_ns += (setup + 10) * 1000LL;  // setup, then the E pulse latches
+    if (!rs && !rw) {
+        hd44780_command(&lcd, cmd, bus_ns);
+    } else if (rs && !rw) {
+        hd44780_write(&lcd, cmd, bus_ns);
+    } else {
+        val = rs ? hd44780_read(&lcd, bus_ns) : hd44780_status(&lcd, bus_ns);
+        if (ret) {
+            *ret = val;
+        }
+    }
+    bus_ns += (udelay + 1) * 1000LL;
+}
+
+static void lcm_data_burst(const unsigned char *data, unsigned int len, unsigned int udelay) {
+    for (unsigned int i = 0; i < len; i++) {
+        if (i > 0) {
+            bus_ns += udelay * 1000LL;
+        }
+        bus_ns += 10000;
+        hd44780_write(&lcd, data[i], bus_ns);
+    }
+    if (len) {
+        bus_ns += (udelay + 1) * 1000LL;
+    }
+}
+
+// LCM_Init() after the port probe, non-adopt path
+static void lcm_init(void) {
+    lcm_command(0, 0, 0x38, 8000, NULL);
+    lcm_command(0, 0, 0x38, 300, NULL);
+    lcm_command(0, 0, 0x38, 300, NULL);
+    lcm_command(0, 0, 0x38, 300, NULL);
+    lcm_command(0, 0, 0x0F, 300, NULL); cur_display = 0x0F;
+    lcm_command(0, 0, 0x01, 3000, NULL);
+    lcm_command(0, 0, 0x06, 300, NULL); cur_entrymode = 0x06;
+    lcm_command(0, 0, 0x80, 300, NULL);
+    for (int i = 0; i < 20; i += PLCM_WRITE_CHUNK) {
+        lcm_data_burst(blank_line + i, PLCM_WRITE_CHUNK, 46);
+    }
+    lcm_command(0, 0, 0xC0, 300, NULL);
+    for (int i = 0; i < 20; i += PLCM_WRITE_CHUNK) {
+        lcm_data_burst(blank_line + i, PLCM_WRITE_CHUNK, 46);
+    }
+    lcm_command(0, 0, 0x40, 300, NULL);
+    for (int i = 0; i < 8; i++) {
+        lcm_data_burst(cursor_glyph, PLCM_WRITE_CHUNK, 46);
+        lcm_data_burst(cursor_glyph + PLCM_WRITE_CHUNK, 8 - PLCM_WRITE_CHUNK, 46);
+    }
+}
+
+// ---- keypad ----
+
+static uint8_t keypad_read(int64_t now) {
+    while (key_next < key_count && key_script[key_next].at_ns <= now) {
+        const key_event_t *ev = &key_script[key_next++];
+        key_code = ev->code;
+        key_up_ns = ev->at_ns + ev->hold_ms * 1000000LL;
+        if (!key_latch) {
+            key_latch = ev->code;
+        }
+        presses++;
+        if (!press_ns) {
+            press_ns = ev->at_ns;
+        }
+    }
+    // Like plcm_drv's keypad_scan_ms latch: a press released again before
+    // this read is still returned once
+    uint8_t val = now < key_up_ns ? key_code : key_latch ? key_latch : KEYPAD_IDLE;
+    key_latch = 0;
+    return val;
+}
+
+static int parse_button(const char *name, uint8_t *code) {
+    static const struct { const char *name; uint8_t code; } buttons[] = {
+        { "up", 0xC7 }, { "down", 0xCF }, { "left", 0xEF }, { "right", 0xE7 },
+    };
+    char *endptr;
+
+    for (size_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+        if (strcmp(name, buttons[i].name) == 0) {
+            *code = buttons[i].code;
+            return 0;
+        }
+    }
+    unsigned long v = strtoul(name, &endptr, 0);
+    if (endptr == name || *endptr != '\0' || v > 0xFF) {
+        return -1;
+    }
+    *code = v;
+    return 0;
+}
+
+// Insert keeping the script sorted by time
+static int add_key_event(int64_t at_ns, uint8_t code, int hold_ms) {
+    if (key_count >= MAX_KEY_EVENTS) {
+        return -1;
+    }
+    int i = key_count++;
+    while (i > key_next && key_script[i - 1].at_ns > at_ns) {
+        key_script[i] = key_script[i - 1];
+        i--;
+    }
+    key_script[i].at_ns = at_ns;
+    key_script[i].code = code;
+    key_script[i].hold_ms = hold_ms;
+    return 0;
+}
+
+// Script lines: "<ms after start> <button> [hold ms]", # comments
+static int load_key_script(const char *path) {
+    char line[128], name[32];
+    long at_ms;
+    int hold_ms, lineno = 0;
+    uint8_t code;
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *s = line + strspn(line, " \t");
+        if (*s == '#' || *s == '\n' || *s == '\0') {
+            continue;
+        }
+        hold_ms = DEFAULT_HOLD_MS;
+        if (sscanf(s, "%ld %31s %d", &at_ms, name, &hold_ms) < 2 || at_ms < 0 || hold_ms <= 0 ||
+            parse_button(name, &code) != 0 || add_key_event(start_ns + at_ms * 1000000LL, code, hold_ms) != 0) {
+            fprintf(stderr, "%s:%d: expected <ms> <up|down|left|right|code> [hold ms]\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// stdin lines: "<button> [hold ms]" pressed now
+static void handle_stdin_line(const char *line) {
+    char name[32];
+    int hold_ms = DEFAULT_HOLD_MS;
+    uint8_t code;
+
+    if (sscanf(line, "%31s %d", name, &hold_ms) < 1) {
+        return;
+    }
+    if (parse_button(name, &code) != 0 || hold_ms <= 0 ||
+        add_key_event(mono_ns(), code, hold_ms) != 0) {
+        fprintf(stderr, "keypad: expected <up|down|left|right|code> [hold ms]\n");
+    }
+}
+
+// ---- driver entry points, mirroring plcm_drv.c ----
+
+static void plcm_read(unsigned char *buf) {
+    unsigned char dd_addr = cur_line == 1 ? 0x80 : 0xC0;
+    uint8_t data;
+
+    lcm_command(0, 0, dd_addr, 300, NULL);
+    for (int i = 0; i < 40; i++) {
+        lcm_command(1, 1, 0x00, 46, &data);
+        buf[i] = data;
+    }
+}
+
+static void plcm_write(const unsigned char *buf, size_t length) {
+    unsigned char msg[40];
+    unsigned char dd_addr = cur_line == 1 ? 0x80 : 0xC0;
+
+    for (int i = 0; i < 40; i++) {
+        msg[i] = (size_t)i < length ? buf[i] : ' ';
+    }
+    lcm_command(0, 0, dd_addr, 300, NULL);
+    for (int i = 0; i < 40; i += PLCM_WRITE_CHUNK) {
+        lcm_data_burst(msg + i, 40 - i < PLCM_WRITE_CHUNK ? 40 - i : PLCM_WRITE_CHUNK, 46);
+    }
+}
+
+static long plcm_write_span(const struct plcm_span *span) {
+    if ((span->line != 1 && span->line != 2) || span->col >= 40 ||
+        span->len == 0 || span->len > 40 - span->col) {
+        return -EINVAL;
+    }
+    if (!(cur_entrymode & 0x02)) {
+        return -EINVAL;
+    }
+    lcm_command(0, 0, (span->line == 1 ? 0x80 : 0xC0) + span->col, 300, NULL);
+    for (int i = 0; i < span->len; i += PLCM_WRITE_CHUNK) {
+        lcm_data_burst(span->data + i, span->len - i < PLCM_WRITE_CHUNK ? span->len - i : PLCM_WRITE_CHUNK, 46);
+    }
+    return 0;
+}
+
+// Set or clear bits in one of the driver's command registers and send it
+static long set_bits(unsigned char *reg, unsigned char bits, unsigned long arg) {
+    if (arg != 0 && arg != 1) {
+        return -EINVAL;
+    }
+    if (arg) {
+        *reg |= bits;
+    } else {
+        *reg &= ~bits;
+    }
+    lcm_command(0, 0, *reg, 300, NULL);
+    return 0;
+}
+
+static long plcm_do_ioctl(unsigned int cmd, unsigned long arg) {
+    switch (cmd) {
+        case PLCM_IOCTL_STOP_THREAD:
+            return 0;
+        case PLCM_IOCTL_BACKLIGHT:
+            if (arg != 0 && arg != 1) {
+                return -EINVAL;
+            }
+            backlight_on = arg;
+            bus_ns += 1000;  // one control port read-modify-write
+            return 0;
+        case PLCM_IOCTL_SET_LINE:
+            if (arg != 1 && arg != 2) {
+                return -EINVAL;
+            }
+            cur_line = arg;
+            lcm_command(0, 0, (arg == 1 ? 0x80 : 0xC0) + row, 300, NULL);
+            return 0;
+        case PLCM_IOCTL_CLEARDISPLAY:
+            lcm_command(0, 0, 0x01, 1640, NULL);
+            row = 0;
+            return 0;
+        case PLCM_IOCTL_RETURNHOME:
+            lcm_command(0, 0, 0x02, 1640, NULL);
+            return 0;
+        case PLCM_IOCTL_ENTRYMODE_ID:
+            return set_bits(&cur_entrymode, 0x02, arg);
+        case PLCM_IOCTL_ENTRYMODE_SH:
+            return set_bits(&cur_entrymode, 0x01, arg);
+        case PLCM_IOCTL_DISPLAY_D:
+            return set_bits(&cur_display, 0x04, arg);
+        case PLCM_IOCTL_DISPLAY_C:
+            return set_bits(&cur_display, 0x02, arg);
+        case PLCM_IOCTL_DISPLAY_B:
+            return set_bits(&cur_display, 0x01, arg);
+        case PLCM_IOCTL_SHIFT_SC:
+            return set_bits(&cur_shift, 0x08, arg);
+        case PLCM_IOCTL_SHIFT_RL:
+            if (arg != 0 && arg != 1) {
+                return -EINVAL;
+            }
+            if (arg == 0) {
+                cur_shift &= ~0x04;
+                if (row > 0 && row < 20) {
+                    lcm_command(0, 0, cur_shift, 300, NULL);
+                    row--;
+                }
+            } else {
+                cur_shift |= 0x04;
+                if (row < 19) {
+                    lcm_command(0, 0, cur_shift, 300, NULL);
+                    row++;
+                }
+            }
+            return 0;
+        case PLCM_IOCTL_GET_KEYPAD:
+            bus_ns += 1000;  // one status port read
+            return keypad_read(mono_ns());
+        case PLCM_IOCTL_INPUT_CHAR:
+            if (arg > 0xFF) {
+                return -EINVAL;
+            }
+            lcm_command(1, 0, (unsigned char)arg, 300, NULL);
+            row++;
+            return 0;
+        default:
+            return -EOPNOTSUPP;
+    }
+}
+
+// ---- panel view ----
+
+static uint8_t shown[2][HD44780_COLS];
+static int shown_backlight = -1;
+
+static void print_stats(FILE *f) {
+    double elapsed = (mono_ns() - start_ns) / 1e9;
+
+    fprintf(f, "requests %lu, opens %lu (%lu refused busy), %.1fs\n", requests, opens, busy_opens, elapsed);
+    fprintf(f, "controller: %lu commands, %lu data writes, %lu data reads, %lu overruns\n",
+            lcd.commands, lcd.data_writes, lcd.data_reads, lcd.overruns);
+    fprintf(f, "bus busy %.1f ms (%.2f%% of the time)\n",
+            bus_busy_ns / 1e6, elapsed > 0 ? bus_busy_ns / 1e7 / elapsed : 0.0);
+    if (latencies) {
+        fprintf(f, "key presses %lu, button-to-pixel min %.1f / avg %.1f / max %.1f ms over %lu\n",
+                presses, lat_min_ns / 1e6, lat_sum_ns / 1e6 / latencies, lat_max_ns / 1e6, latencies);
+    } else {
+        fprintf(f, "key presses %lu\n", presses);
+    }
+}
+
+static void show_panel(int tty) {
+    uint8_t vis[2][HD44780_COLS];
+    int cline = -1, ccol = -1;
+
+    hd44780_visible(&lcd, vis);
+    if (memcmp(vis, shown, sizeof(vis)) == 0 && backlight_on == shown_backlight) {
+        return;
+    }
+    int changed = memcmp(vis, shown, sizeof(vis)) != 0;
+    memcpy(shown, vis, sizeof(vis));
+    shown_backlight = backlight_on;
+
+    int64_t now = mono_ns();
+    if (changed && press_ns) {
+        int64_t lat = now - press_ns;
+        if (!latencies || lat < lat_min_ns) lat_min_ns = lat;
+        if (lat > lat_max_ns) lat_max_ns = lat;
+        lat_sum_ns += lat;
+        latencies++;
+        press_ns = 0;
+        if (!tty) {
+            printf("[%9.3f] key -> panel %.1f ms\n", (now - start_ns) / 1e9, lat / 1e6);
+        }
+    }
+
+    char text[2][HD44780_COLS + 1];
+    for (int l = 0; l < 2; l++) {
+        for (int c = 0; c < HD44780_COLS; c++) {
+            uint8_t ch = vis[l][c];
+            text[l][c] = ch < 0x10 ? '#' : (ch < 0x20 || ch > 0x7E) ? '?' : ch;  // # = CGRAM glyph
+        }
+        text[l][HD44780_COLS] = '\0';
+    }
+    hd44780_cursor(&lcd, &cline, &ccol);
+
+    if (tty) {
+        printf("\033[H\033[2J");
+        printf("+--------------------+\n|%s|\n|%s|\n+--------------------+\n", text[0], text[1]);
+        printf("backlight %s, display %s, cursor %s%s", backlight_on ? "on" : "off",
+               (lcd.display & 0x04) ? "on" : "off", (lcd.display & 0x02) ? "on" : "off",
+               (lcd.display & 0x01) ? " (blink)" : "");
+        if (cline >= 0) {
+            printf(" at %d:%d", cline + 1, ccol + 1);
+        }
+        printf("\n\n");
+        print_stats(stdout);
+    } else {
+        printf("[%9.3f] |%s|%s|%s\n", (now - start_ns) / 1e9, text[0], text[1],
+               backlight_on ? "" : " (backlight off)");
+    }
+    fflush(stdout);
+}
+
+// ---- CUSE ----
+
+static int cuse_fd = -1;
+static int64_t req_start_ns, req_bus_start_ns;  // request being handled
+
+// Hold the caller as long as the real bus would have, by delaying the reply
+static void hold_caller(void) {
+    if (time_scale <= 0 || bus_ns <= req_bus_start_ns) {
+        return;
+    }
+    int64_t due = req_start_ns + (int64_t)((bus_ns - req_bus_start_ns) * time_scale);
+    struct timespec ts = { due / 1000000000LL, due % 1000000000LL };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop) {
+    }
+}
+
+static int reply(uint64_t unique, int error, const void *a, size_t alen, const void *b, size_t blen) {
+    struct fuse_out_header out;
+    struct iovec iov[3] = {
+        { &out, sizeof(out) },
+        { (void *)a, alen },
+        { (void *)b, blen },
+    };
+
+    hold_caller();
+    out.len = sizeof(out) + alen + blen;
+    out.error = error;
+    out.unique = unique;
+    if (writev(cuse_fd, iov, 3) < 0 && errno != ENOENT) {  // ENOENT: request was interrupted
+        return -1;
+    }
+    return 0;
+}
+
+static int cuse_init(const char *devname) {
+    static char buf[EMU_REQ_BUF];
+    char info[64];
+
+    ssize_t n = read(cuse_fd, buf, sizeof(buf));
+    const struct fuse_in_header *in = (const void *)buf;
+    const struct cuse_init_in *init = (const void *)(in + 1);
+    if (n < (ssize_t)(sizeof(*in) + sizeof(*init)) || in->opcode != CUSE_INIT) {
+        fprintf(stderr, "Unexpected first request from %s\n", CUSE_DEVICE);
+        return -1;
+    }
+    if (init->major != FUSE_KERNEL_VERSION) {
+        fprintf(stderr, "Kernel speaks FUSE %u, need %d\n", init->major, FUSE_KERNEL_VERSION);
+        reply(in->unique, -EPROTO, NULL, 0, NULL, 0);
+        return -1;
+    }
+
+    struct cuse_init_out out;
+    memset(&out, 0, sizeof(out));
+    out.major = FUSE_KERNEL_VERSION;
+    out.minor = init->minor < FUSE_KERNEL_MINOR_VERSION ? init->minor : FUSE_KERNEL_MINOR_VERSION;
+    out.flags = CUSE_UNRESTRICTED_IOCTL;  // PLCM ioctl numbers carry no size
+    out.max_read = EMU_MAX_IO;
+    out.max_write = EMU_MAX_IO;
+    int len = snprintf(info, sizeof(info), "DEVNAME=%s", devname);
+    return reply(in->unique, 0, &out, sizeof(out), info, len + 1);
+}
+
+static void handle_ioctl(const struct fuse_in_header *in, const struct fuse_ioctl_in *arg, const void *data) {
+    struct fuse_ioctl_out out;
+    long ret;
+
+    memset(&out, 0, sizeof(out));
+    if (arg->cmd == PLCM_IOCTL_WRITE_SPAN) {
+        if (arg->in_size < sizeof(struct plcm_span)) {
+            // Ask the kernel to fetch the struct from the caller and retry
+            struct fuse_ioctl_iovec iov = { arg->arg, sizeof(struct plcm_span) };
+            out.flags = FUSE_IOCTL_RETRY;
+            out.in_iovs = 1;
+            reply(in->unique, 0, &out, sizeof(out), &iov, sizeof(iov));
+            return;
+        }
+        ret = plcm_write_span(data);
+    } else {
+        ret = plcm_do_ioctl(arg->cmd, arg->arg);
+    }
+    if (ret < 0) {
+        reply(in->unique, ret, NULL, 0, NULL, 0);
+        return;
+    }
+    out.result = ret;
+    reply(in->unique, 0, &out, sizeof(out), NULL, 0);
+}
+
+// One request from the kernel; returns -1 when the device went away
+static int handle_request(const char *buf, ssize_t n) {
+    const struct fuse_in_header *in = (const void *)buf;
+    const void *body = in + 1;
+    unsigned char data[40];
+
+    if (n < (ssize_t)sizeof(*in)) {
+        return -1;
+    }
+    requests++;
+
+    switch (in->opcode) {
+        case FUSE_OPEN: {
+            // One client at a time, like the driver
+            struct fuse_open_out out;
+            if (device_open) {
+                busy_opens++;
+                return reply(in->unique, -EBUSY, NULL, 0, NULL, 0);
+            }
+            device_open = 1;
+            opens++;
+            memset(&out, 0, sizeof(out));
+            out.fh = 1;
+            return reply(in->unique, 0, &out, sizeof(out), NULL, 0);
+        }
+        case FUSE_RELEASE:
+            device_open = 0;
+            return reply(in->unique, 0, NULL, 0, NULL, 0);
+        case FUSE_FLUSH:
+            return reply(in->unique, 0, NULL, 0, NULL, 0);
+        case FUSE_READ: {
+            const struct fuse_read_in *arg = body;
+            if (arg->size != 40) {
+                return reply(in->unique, 0, NULL, 0, NULL, 0);  // driver returns 0
+            }
+            plcm_read(data);
+            return reply(in->unique, 0, data, sizeof(data), NULL, 0);
+        }
+        case FUSE_WRITE: {
+            const struct fuse_write_in *arg = body;
+            struct fuse_write_out out;
+            memset(&out, 0, sizeof(out));
+            if (arg->size <= 40) {
+                plcm_write((const unsigned char *)(arg + 1), arg->size);
+                // The driver claims 40 for short writes too; FUSE rejects
+                // more than was asked for, so report what was passed
+                out.size = arg->size;
+            }
+            return reply(in->unique, 0, &out, sizeof(out), NULL, 0);
+        }
+        case FUSE_IOCTL: {
+            const struct fuse_ioctl_in *arg = body;
+            handle_ioctl(in, arg, arg + 1);
+            return 0;
+        }
+        case FUSE_INTERRUPT:
+            return 0;  // requests are handled synchronously, nothing to cancel
+        default:
+            return reply(in->unique, -ENOSYS, NULL, 0, NULL, 0);
+    }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-k script] [-i] [-t scale] [-n devname] [-q]\n"
+            "  -k  keypad script, lines of \"<ms> <up|down|left|right|code> [hold ms]\"\n"
+            "  -i  read \"<button> [hold ms]\" presses from stdin\n"
+            "  -t  fraction of the simulated bus time to actually wait (default 1, 0 = none)\n"
+            "  -n  device name (default %s)\n"
+            "  -q  don't print the panel\n",
+            prog, DEFAULT_DEVNAME);
+}
+
+int main(int argc, char *argv[]) {
+    static char buf[EMU_REQ_BUF];
+    const char *devname = DEFAULT_DEVNAME;
+    const char *script = NULL;
+    int interactive = 0, quiet = 0, opt;
+    char line[128];
+    size_t line_len = 0;
+
+    while ((opt = getopt(argc, argv, "k:it:n:qh")) != -1) {
+        switch (opt) {
+            case 'k': script = optarg; break;
+            case 'i': interactive = 1; break;
+            case 't': time_scale = atof(optarg); break;
+            case 'n': devname = optarg; break;
+            case 'q': quiet = 1; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    start_ns = mono_ns();
+    if (script && load_key_script(script) != 0) {
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;  // no SA_RESTART: poll() returns with EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    cuse_fd = open(CUSE_DEVICE, O_RDWR | O_CLOEXEC);
+    if (cuse_fd < 0) {
+        fprintf(stderr, "%s: %s (is the cuse module loaded?)\n", CUSE_DEVICE, strerror(errno));
+        return 1;
+    }
+    if (cuse_init(devname) != 0) {
+        return 1;
+    }
+    fprintf(stderr, "Serving /dev/%s\n", devname);
+
+    hd44780_reset(&lcd);
+    bus_ns = mono_ns();
+    lcm_init();  // as plcm_drv does on load
+    int tty = isatty(STDOUT_FILENO);
+
+    struct pollfd pfd[2] = {
+        { cuse_fd, POLLIN, 0 },
+        { interactive ? STDIN_FILENO : -1, POLLIN, 0 },
+    };
+    while (!stop) {
+        if (!quiet) {
+            show_panel(tty);
+        }
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (pfd[1].revents) {
+            ssize_t n = read(STDIN_FILENO, line + line_len, sizeof(line) - 1 - line_len);
+            if (n <= 0) {
+                pfd[1].fd = -1;  // EOF: keep serving the device
+            } else {
+                line_len += n;
+                line[line_len] = '\0';
+                char *nl;
+                while ((nl = strchr(line, '\n')) != NULL) {
+                    *nl = '\0';
+                    handle_stdin_line(line);
+                    line_len -= nl + 1 - line;
+                    memmove(line, nl + 1, line_len + 1);
+                }
+                if (line_len == sizeof(line) - 1) {
+                    line_len = 0;  // overlong line, drop it
+                }
+            }
+        }
+
+        if (pfd[0].revents) {
+            ssize_t n = read(cuse_fd, buf, sizeof(buf));
+            if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == ENOENT)) {
+                continue;
+            }
+            if (n <= 0) {
+                break;  // ENODEV: device torn down
+            }
+
+            // Idle time passes on the bus too; then run the request
+            req_start_ns = mono_ns();
+            if (bus_ns < req_start_ns) {
+                bus_ns = req_start_ns;
+            }
+            req_bus_start_ns = bus_ns;
+            if (handle_request(buf, n) != 0) {
+                break;
+            }
+            bus_busy_ns += bus_ns - req_bus_start_ns;
+        }
+    }
+
+    print_stats(stderr);
+    close(cuse_fd);
+    return 0;
+}
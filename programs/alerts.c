@@ -0,0 +1,45 @@
+#include "alerts.h"
+
+#define SEC(x)  ((int64_t)(x) * 1000000000LL)
+
+static int over(const alert_rule_t *rule, long value) {
+    return rule->op == ALERT_ABOVE ? value > rule->threshold : value < rule->threshold;
+}
+
+static int back(const alert_rule_t *rule, long value) {
+    return rule->op == ALERT_ABOVE ? value <= rule->clear : value >= rule->clear;
+}
+
+int alert_eval(const alert_rule_t *rule, alert_state_t *st, int64_t now_ns) {
+    const metric_value_t *m = metric_get(rule->metric);
+
+    if (m->samples != st->seen) {
+        st->seen = m->samples;
+        if (!m->valid) {
+            // No reading proves nothing: a pending raise starts over, an
+            // active alert stays up
+            st->pending_ns = 0;
+        } else {
+            st->value = m->value;
+            if (!over(rule, m->value)) {
+                st->pending_ns = 0;
+            } else if (st->pending_ns == 0) {
+                st->pending_ns = m->sampled_ns;
+            }
+        }
+    }
+
+    if (!st->active) {
+        if (st->pending_ns != 0 && now_ns - st->pending_ns >= SEC(rule->for_s)) {
+            st->active = 1;
+            st->raised_ns = now_ns;
+            st->raised++;
+            return 1;
+        }
+    } else if (m->valid && back(rule, st->value) && now_ns - st->raised_ns >= SEC(rule->hold_s)) {
+        st->active = 0;
+        st->pending_ns = 0;
+        return -1;
+    }
+    return 0;
+}
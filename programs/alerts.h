@@ -0,0 +1,58 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include <stdint.h>
+#include "metrics.h"
+
+// Threshold alerts on the metrics registry, declared in the screen config:
+//
+//   [alert cpu_hot]
+//   metric = cpu_temp
+//   above = 85          raise when the value goes over 85...
+//   for = 5             ...and stays there for 5s
+//   clear = 80          clear only once it is back at 80 or below...
+//   hold = 30           ...and the alert has been up for at least 30s
+//   screen = system     line 1 screen to pin while active
+//   blink = yes         blink the backlight while active
+//
+// A rule is evaluated incrementally: each new sample of its metric moves the
+// condition, and the for/hold timers run off the last sample, so the values
+// are read no more often than the metric's own refresh interval. The gap
+// between the raise and clear thresholds plus the minimum hold keep a value
+// sitting on the threshold from making the panel flap.
+
+#define ALERT_MAX           8
+
+typedef enum {
+    ALERT_ABOVE,                 // raise when value > threshold
+    ALERT_BELOW,                 // raise when value < threshold
+} alert_op_t;
+
+typedef struct {
+    char name[16];
+    metric_id_t metric;
+    alert_op_t op;
+    int threshold;
+    int clear;                   // clear at or back past this (hysteresis)
+    int for_s;                   // condition must last this long to raise
+    int hold_s;                  // minimum time active
+    char screen_name[16];        // "" = don't pin a screen
+    int screen;                  // index of screen_name, -1 = none
+    int blink;
+} alert_rule_t;
+
+typedef struct {
+    int active;
+    int64_t pending_ns;          // condition true since (first sample), 0 = not
+    int64_t raised_ns;           // when it went active
+    unsigned long seen;          // metric samples already evaluated
+    long value;                  // last value evaluated
+    unsigned long raised;        // times raised
+} alert_state_t;
+
+// Evaluate one rule: take a new sample of its metric if one is due, then
+// apply the for/hold timers. Returns 1 if the alert was raised, -1 if it
+// cleared, 0 if nothing changed.
+int alert_eval(const alert_rule_t *rule, alert_state_t *st, int64_t now_ns);
+
+#endif // ALERTS_H
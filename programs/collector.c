@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "collector.h"
+
+#define READ_RETRIES 100
+
+typedef struct {
+    uint32_t seq;                // seqlock: odd while the worker writes
+    metric_value_t value;
+} collect_slot_t;
+
+typedef struct {
+    int kick_fd;                 // eventfd, written when wanted went non-empty
+    uint32_t wanted;             // bit per metric_id_t, taken by the worker
+} collect_worker_t;
+
+static collect_slot_t slots[METRIC_COUNT];       // one writer each: the metric's worker
+static metric_value_t work[METRIC_COUNT];        // the workers' own copies
+static uint32_t copied_seq[METRIC_COUNT];        // reader: slot seq last copied
+static collect_worker_t workers[COLLECT_WORKERS];
+static uint32_t pending;                         // requested, not published yet
+static int done_fd = -1;
+static int collector_state = 0;                  // 0 not started, 1 running, -1 unavailable
+static int sched_err;                            // from setting SCHED_BATCH, 0 if it worked
+static __thread int sample_changed;              // set by collector_changed()
+static int settling;                             // collector_settle() waits for every batch
+
+// Directory walks grow with the system; keep them away from the cheap reads
+static int worker_of(metric_id_t id) {
+    return metric_desc(id)->cost == METRIC_COST_SCAN ? 1 : 0;
+}
+
+static void publish(metric_id_t id) {
+    collect_slot_t *s = &slots[id];
+    uint32_t seq = s->seq;
+
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&s->value, &work[id], sizeof(s->value));
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Whether a fresh sample is worth waking the reader for: it reads
+// differently, or the last one is old enough that the reader may show the
+// value as stale
+static int sample_differs(metric_id_t id, const metric_value_t *old, const metric_value_t *m) {
+    int64_t stale_ns = ((int64_t)metric_desc(id)->min_interval_ms + METRIC_STALE_SLACK_MS) * 1000000LL;
+
+    return m->valid != old->valid || m->value != old->value ||
+           strcmp(m->text, old->text) != 0 || m->sampled_ns - old->sampled_ns > stale_ns;
+}
+
+static void *worker(void *arg) {
+    collect_worker_t *w = arg;
+    metric_value_t old;
+    uint64_t v;
+
+    for (;;) {
+        if (read(w->kick_fd, &v, sizeof(v)) != sizeof(v)) {
+            continue;
+        }
+        uint32_t want = __atomic_exchange_n(&w->wanted, 0, __ATOMIC_ACQ_REL);
+        int changed = 0;
+        for (int id = 0; id < METRIC_COUNT; id++) {
+            if (!(want & (1u << id))) {
+                continue;
+            }
+            metric_value_t *m = &work[id];
+            old = *m;
+            sample_changed = 0;
+            m->valid = metric_desc(id)->sample(m) == 0;
+            m->sampled_ns = metrics_now_ns();
+            m->samples++;
+            changed |= sample_changed || sample_differs(id, &old, m);
+            publish(id);
+            __atomic_fetch_and(&pending, ~(1u << id), __ATOMIC_RELEASE);
+        }
+        v = 1;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if ((changed || __atomic_load_n(&settling, __ATOMIC_RELAXED)) &&
+            write(done_fd, &v, sizeof(v)) < 0) {
+            // Counter full: the reader has a wakeup coming anyway
+        }
+    }
+    return NULL;
+}
+
+int collector_start(void) {
+    struct sched_param batch = { .sched_priority = 0 };
+    pthread_t thread;
+    sigset_t all, old;
+
+    if (collector_state != 0) {
+        return collector_state > 0 ? 0 : -1;
+    }
+    collector_state = -1;
+    done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (done_fd < 0) {
+        return -1;
+    }
+    for (int i = 0; i < COLLECT_WORKERS; i++) {
+        workers[i].kick_fd = eventfd(0, EFD_CLOEXEC);
+        if (workers[i].kick_fd < 0) {
+            return -1;
+        }
+    }
+
+    // Workers must not take the process's signals (the daemon reads them
+    // from a signalfd); they inherit this mask
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = 0;
+    for (int i = 0; i < COLLECT_WORKERS && err == 0; i++) {
+        err = pthread_create(&thread, NULL, worker, &workers[i]);
+        if (err == 0) {
+            // A kick must not preempt the renderer that sent it: batch
+            // threads don't get wakeup preemption and run when it sleeps
+            int e = pthread_setschedparam(thread, SCHED_BATCH, &batch);
+            if (e != 0) {
+                sched_err = e;
+            }
+            pthread_detach(thread);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        // A worker that did start only ever runs on request; none will come
+        return -1;
+    }
+    __atomic_store_n(&collector_state, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int collector_sched_error(void) {
+    return sched_err;
+}
+
+void collector_changed(void) {
+    sample_changed = 1;
+}
+
+void collector_request(metric_id_t id) {
+    uint32_t bit = 1u << id;
+    collect_worker_t *w = &workers[worker_of(id)];
+    uint64_t v = 1;
+
+    if (__atomic_load_n(&collector_state, __ATOMIC_ACQUIRE) <= 0) {
+        return;  // sampled in place then
+    }
+    if (__atomic_fetch_or(&pending, bit, __ATOMIC_ACQ_REL) & bit) {
+        return;  // already on its way
+    }
+    if (__atomic_fetch_or(&w->wanted, bit, __ATOMIC_ACQ_REL) == 0 &&
+        write(w->kick_fd, &v, sizeof(v)) < 0) {
+        // Counter full: the worker is behind on kicks, not on this bit
+    }
+}
+
+void collector_read(metric_id_t id, metric_value_t *v) {
+    const collect_slot_t *s = &slots[id];
+    metric_value_t tmp;
+
+    for (int i = 0; i < READ_RETRIES; i++) {
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq == copied_seq[id]) {
+            return;  // nothing new
+        }
+        if (seq & 1) {
+            continue;  // Writer in progress
+        }
+        memcpy(&tmp, &s->value, sizeof(tmp));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq) {
+            memcpy(v, &tmp, sizeof(*v));
+            copied_seq[id] = seq;
+            return;
+        }
+    }
+    // Kept being rewritten: *v stays at the previous value this time
+}
+
+int collector_fd(void) {
+    return collector_start() == 0 ? done_fd : -1;
+}
+
+void collector_drain(void) {
+    uint64_t v;
+
+    if (done_fd >= 0 && read(done_fd, &v, sizeof(v)) < 0) {
+        // EAGAIN: nothing was posted
+    }
+}
+
+int collector_settle(int timeout_ms) {
+    int64_t end = metrics_now_ns() + (int64_t)timeout_ms * 1000000LL;
+    struct pollfd pfd = { .fd = done_fd, .events = POLLIN };
+    int ret = 0;
+
+    if (collector_state <= 0) {
+        return 0;
+    }
+    // Have batches that changed nothing posted too while waiting. The
+    // fences pair with the worker's: either it sees the flag or this sees
+    // its request done.
+    __atomic_store_n(&settling, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&pending, __ATOMIC_ACQUIRE) != 0) {
+        int64_t left_ms = (end - metrics_now_ns()) / 1000000LL;
+        if (left_ms <= 0) {
+            ret = -1;
+            break;
+        }
+        poll(&pfd, 1, (int)left_ms);
+        collector_drain();
+    }
+    __atomic_store_n(&settling, 0, __ATOMIC_RELAXED);
+    return ret;
+}
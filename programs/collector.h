@@ -0,0 +1,54 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <stdint.h>
+#include "metrics.h"
+
+// Worker pool that samples the metrics registry off the caller's thread.
+//
+// Each metric belongs to one worker (directory walks get their own, so a
+// slow /proc scan doesn't hold up the cheap reads), which is the only
+// writer of that metric's result slot. A slot is published under a
+// seqlock: collector_read() copies the latest completed value without
+// taking a lock or waiting, and a sample still running simply isn't
+// visible yet. collector_request() only sets a bit and, if the worker was
+// idle, writes its eventfd.
+//
+// Workers post to collector_fd() after a batch in which a value changed,
+// so an event loop can repaint as soon as there is something new to show
+// instead of on its next tick, and isn't woken for samples that read the
+// same as before.
+
+#define COLLECT_WORKERS     2
+
+// Start the workers (once). Returns 0, or -1 if they could not be started
+// (metrics are then sampled in place).
+int collector_start(void);
+
+// 0 if the workers run SCHED_BATCH, else the error that kept them on the
+// default policy (EPERM where a seccomp filter denies sched_setscheduler)
+int collector_sched_error(void);
+
+// Ask the metric's worker for a fresh sample; no-op while one is pending or
+// if the workers aren't running. Safe from any thread.
+void collector_request(metric_id_t id);
+
+// Copy the latest published value of id into *v if it changed since the
+// last copy. Meant for one reader thread (the one calling metric_get()).
+void collector_read(metric_id_t id, metric_value_t *v);
+
+// For samplers that publish more than their value (the address list,
+// lcd_render.h): count the sample running on this thread as changed even
+// if its value is the same
+void collector_changed(void);
+
+// eventfd readable after workers published changed results (-1 if not
+// started); collector_drain() resets it
+int collector_fd(void);
+void collector_drain(void);
+
+// Wait up to timeout_ms until no request is pending. Returns 0, or -1 on
+// timeout. For one-shot callers; an event loop uses collector_fd().
+int collector_settle(int timeout_ms);
+
+#endif // COLLECTOR_H
@@ -0,0 +1,163 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "ctl_socket.h"
+
+static int make_addr(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int ctl_listen(const char *path) {
+    struct sockaddr_un addr;
+
+    if (make_addr(path, &addr) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);  // left over from a daemon that didn't exit cleanly
+    // 0660: members of the daemon's group (lcd) may post messages with lcdctl
+    mode_t old = umask(0117);
+    int ok = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, 4) == 0;
+    umask(old);
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void ctl_conns_init(ctl_conn_t *conns, int n) {
+    for (int i = 0; i < n; i++) {
+        conns[i].fd = -1;
+    }
+}
+
+int ctl_accept(int lfd, ctl_conn_t *conns, int n, int64_t now_ns) {
+    for (int i = 0; i < n; i++) {
+        if (conns[i].fd < 0) {
+            int cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (cfd < 0) {
+                return -1;
+            }
+            conns[i].fd = cfd;
+            conns[i].got = 0;
+            conns[i].deadline_ns = now_ns + CTL_TIMEOUT_MS * 1000000LL;
+            return i;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+static void conn_close(ctl_conn_t *c) {
+    close(c->fd);
+    c->fd = -1;
+}
+
+int ctl_read(ctl_conn_t *c) {
+    size_t max = sizeof(c->req) - 1;
+    int eof = 0;
+
+    // Requests are one short line; it is complete at the newline, when the
+    // client shuts down its side or when the buffer is full
+    while (c->got < max) {
+        ssize_t n = read(c->fd, c->req + c->got, max - c->got);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            break;
+        }
+        if (n <= 0) {
+            eof = 1;
+            break;
+        }
+        c->got += n;
+        if (memchr(c->req + c->got - n, '\n', n)) {
+            break;
+        }
+    }
+    c->req[c->got] = '\0';
+    if (c->got > 0 && (eof || c->got == max || strchr(c->req, '\n'))) {
+        c->req[strcspn(c->req, "\r\n")] = '\0';
+        return 1;
+    }
+    if (eof) {
+        conn_close(c);
+        return -1;
+    }
+    return 0;
+}
+
+int64_t ctl_expire(ctl_conn_t *conns, int n, int64_t now_ns, int *nfree) {
+    int64_t next = 0;
+
+    *nfree = 0;
+    for (int i = 0; i < n; i++) {
+        if (conns[i].fd >= 0 && conns[i].deadline_ns <= now_ns) {
+            conn_close(&conns[i]);
+        }
+        if (conns[i].fd < 0) {
+            (*nfree)++;
+        } else if (next == 0 || conns[i].deadline_ns < next) {
+            next = conns[i].deadline_ns;
+        }
+    }
+    return next;
+}
+
+void ctl_reply(ctl_conn_t *c, const char *reply, size_t len) {
+    while (len > 0) {
+        // No SIGPIPE if the client gave up before its answer came
+        ssize_t n = send(c->fd, reply, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;  // client went away, or its socket is full
+        }
+        reply += n;
+        len -= n;
+    }
+    conn_close(c);
+}
+
+int ctl_query(const char *path, const char *request, FILE *out) {
+    struct sockaddr_un addr;
+    char buf[4096];
+    ssize_t n;
+
+    if (make_addr(path, &addr) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        write(fd, request, strlen(request)) != (ssize_t)strlen(request) || write(fd, "\n", 1) != 1) {
+        close(fd);
+        return -1;
+    }
+    shutdown(fd, SHUT_WR);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, n, out);
+    }
+    close(fd);
+    return n < 0 ? -1 : 0;
+}
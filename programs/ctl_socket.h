@@ -0,0 +1,60 @@
+#ifndef CTL_SOCKET_H
+#define CTL_SOCKET_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Query socket of lcd_button_daemon.
+//
+// A client connects to the Unix stream socket, sends one request line and
+// reads the reply until the daemon closes the connection. The socket is
+// mode 0660, owned by the daemon's user and group.
+//
+// Client sockets are non-blocking and the daemon collects request bytes as
+// its event loop sees them arrive, so a slow client never stalls the
+// display. A request not complete within CTL_TIMEOUT_MS of the connect is
+// dropped, and a reply the socket can't take at once is cut short.
+
+#define LCD_CTL_SOCKET      "/run/lcd_button_daemon.sock"
+#define CTL_TIMEOUT_MS      100
+#define CTL_REQUEST_MAX     256
+#define CTL_MAX_CLIENTS     4    // requests being read at the same time
+
+// A client whose request is (still) being read
+typedef struct {
+    int fd;                      // -1: slot free
+    size_t got;
+    int64_t deadline_ns;         // CLOCK_MONOTONIC
+    char req[CTL_REQUEST_MAX];   // the request line, once complete
+} ctl_conn_t;
+
+// Bind and listen (non-blocking), replacing a stale socket file.
+// Returns the listening fd or -1.
+int ctl_listen(const char *path);
+
+void ctl_conns_init(ctl_conn_t *conns, int n);
+
+// Accept one client into a free slot of conns, with its deadline
+// CTL_TIMEOUT_MS from now_ns. Returns the slot, or -1 with errno set if
+// nothing was accepted: EAGAIN if no client was waiting or all slots are
+// busy (clients are then left in the listen backlog), else accept4()'s.
+int ctl_accept(int lfd, ctl_conn_t *conns, int n, int64_t now_ns);
+
+// Read what the client has sent so far. Returns 1 once the request line is
+// complete (in c->req, without the newline), 0 if more is to come, -1 if
+// the client went away without a request (it is closed).
+int ctl_read(ctl_conn_t *c);
+
+// Close the clients whose deadline has passed and count the free slots
+// into *nfree. Returns the earliest deadline still pending, 0 if none.
+int64_t ctl_expire(ctl_conn_t *conns, int n, int64_t now_ns, int *nfree);
+
+// Send as much of the reply as the socket takes without blocking and close
+// the client
+void ctl_reply(ctl_conn_t *c, const char *reply, size_t len);
+
+// Client side: send request, copy the reply to out. Returns 0 or -1.
+int ctl_query(const char *path, const char *request, FILE *out);
+
+#endif // CTL_SOCKET_H
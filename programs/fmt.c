@@ -0,0 +1,239 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "fmt.h"
+
+static int put_uint(char *out, uint64_t v) {
+    char tmp[20];
+    int n = 0, len;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (len = 0; n > 0; len++) {
+        out[len] = tmp[--n];
+    }
+    return len;
+}
+
+static int put_2digits(char *out, int v) {
+    out[0] = (char)('0' + v / 10 % 10);
+    out[1] = (char)('0' + v % 10);
+    return 2;
+}
+
+int fmt_int(char *out, long v) {
+    int len = 0;
+
+    if (v < 0) {
+        out[len++] = '-';
+        len += put_uint(out + len, -(uint64_t)v);
+    } else {
+        len += put_uint(out + len, (uint64_t)v);
+    }
+    out[len] = '\0';
+    return len;
+}
+
+int fmt_hundredths(char *out, long v) {
+    int len = 0;
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+
+    if (v < 0) {
+        out[len++] = '-';
+    }
+    len += put_uint(out + len, u / 100);
+    out[len++] = '.';
+    len += put_2digits(out + len, (int)(u % 100));
+    out[len] = '\0';
+    return len;
+}
+
+int fmt_pct(char *out, int pct) {
+    int len = fmt_int(out, pct);
+
+    out[len++] = '%';
+    out[len] = '\0';
+    return len;
+}
+
+int fmt_bytes(char *out, uint64_t bytes) {
+    static const char units[] = "MGTPE";
+    int len;
+
+    if (bytes < 1024) {
+        len = put_uint(out, bytes);
+        out[len++] = 'B';
+    } else if (bytes < 1024 * 1024) {
+        len = put_uint(out, bytes / 1024);
+        out[len++] = 'K';
+    } else {
+        // Tenths of the unit, rounded, from the KiB count so nothing overflows
+        uint64_t scaled = bytes / 1024;
+        int u = 0;
+        uint64_t tenths = (scaled * 10 + 512) / 1024;
+        while (tenths >= 10240 && units[u + 1]) {
+            scaled /= 1024;
+            u++;
+            tenths = (scaled * 10 + 512) / 1024;
+        }
+        len = put_uint(out, tenths / 10);
+        out[len++] = '.';
+        out[len++] = (char)('0' + tenths % 10);
+        out[len++] = units[u];
+    }
+    out[len] = '\0';
+    return len;
+}
+
+int fmt_uptime(char *out, long seconds) {
+    int len;
+
+    if (seconds < 0) {
+        out[0] = '?';
+        out[1] = '\0';
+        return 1;
+    }
+    long days = seconds / 86400;
+    int hours = (int)(seconds % 86400 / 3600);
+    int mins = (int)(seconds % 3600 / 60);
+
+    if (days > 0) {
+        len = put_uint(out, (uint64_t)days);
+        out[len++] = 'd';
+        len += put_uint(out + len, (uint64_t)hours);
+        out[len++] = 'h';
+    } else if (hours > 0) {
+        len = put_uint(out, (uint64_t)hours);
+        out[len++] = 'h';
+        len += put_uint(out + len, (uint64_t)mins);
+        out[len++] = 'm';
+    } else {
+        len = put_uint(out, (uint64_t)mins);
+        out[len++] = 'm';
+    }
+    out[len] = '\0';
+    return len;
+}
+
+int fmt_clock(char *out, int h, int m, int s) {
+    put_2digits(out, h);
+    out[2] = ':';
+    put_2digits(out + 3, m);
+    out[5] = ':';
+    put_2digits(out + 6, s);
+    out[8] = '\0';
+    return 8;
+}
+
+int fmt_ipv4(char *out, const void *addr) {
+    const unsigned char *b = addr;
+    int len = 0;
+
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+            out[len++] = '.';
+        }
+        len += put_uint(out + len, b[i]);
+    }
+    out[len] = '\0';
+    return len;
+}
+
+int fmt_str(char *out, size_t outlen, const char *s) {
+    size_t len = strnlen(s, outlen - 1);
+
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return (int)len;
+}
+
+void fmt_append(char *buf, size_t len, size_t *pos, const char *fmt, ...) {
+    va_list ap;
+
+    if (*pos >= len) {
+        return;
+    }
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *pos, len - *pos, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        *pos += (size_t)n < len - *pos ? (size_t)n : len - *pos - 1;
+    }
+}
+
+// Width of the shown fields laid out together; *skip gets the leading
+// spaces of the first one if fields before it were dropped (its separator
+// from them), which are not printed
+static int shown_width(const fmt_field_t *f, int n, uint32_t shown, int *skip) {
+    int width = 0, first = 1;
+
+    *skip = 0;
+    for (int i = 0; i < n; i++) {
+        if (!(shown & (1u << i))) {
+            continue;
+        }
+        if (first && i > 0) {
+            while (*skip < f[i].len && f[i].text[*skip] == ' ') {
+                (*skip)++;
+            }
+        }
+        first = 0;
+        width += f[i].len;
+    }
+    return width - *skip;
+}
+
+int fmt_line(char *line, int cols, const fmt_field_t *f, int n, fmt_align_t align) {
+    uint32_t shown;
+    int nshown, skip, width;
+
+    if (n > FMT_MAX_FIELDS) {
+        n = FMT_MAX_FIELDS;
+    }
+    shown = n > 0 ? (1u << n) - 1 : 0;
+    nshown = n;
+    width = shown_width(f, n, shown, &skip);
+
+    // Drop the least important field (the rightmost of equals) until the
+    // rest fits or only one is left
+    while (width > cols && nshown > 1) {
+        int drop = -1;
+        for (int i = n - 1; i >= 0; i--) {
+            if ((shown & (1u << i)) && (drop < 0 || f[i].prio < f[drop].prio)) {
+                drop = i;
+            }
+        }
+        shown &= ~(1u << drop);
+        nshown--;
+        width = shown_width(f, n, shown, &skip);
+    }
+    if (width > cols) {
+        width = cols;
+    }
+
+    int pos = align == FMT_RIGHT ? cols - width : align == FMT_CENTER ? (cols - width) / 2 : 0;
+    int end = pos + width;
+
+    memset(line, ' ', cols);
+    for (int i = 0; i < n && pos < end; i++) {
+        if (!(shown & (1u << i))) {
+            continue;
+        }
+        const char *src = f[i].text + skip;
+        int len = f[i].len - skip;
+        skip = 0;
+        if (len > end - pos) {
+            len = end - pos;
+        }
+        memcpy(line + pos, src, len);
+        pos += len;
+    }
+    return width;
+}
+
+int fmt_text(char *line, int cols, const char *s, fmt_align_t align) {
+    fmt_field_t f = { s, (int)strnlen(s, cols), 0 };
+    return fmt_line(line, cols, &f, 1, align);
+}
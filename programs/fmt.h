@@ -0,0 +1,63 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-width formatting for the 20-column panel, integer only and without
+// libc formatting, so composing a frame costs a few stores per character.
+//
+// The value formatters write a NUL-terminated string into out, which must
+// hold FMT_MAX bytes (INET_ADDRSTRLEN for fmt_ipv4), and return its length:
+//   fmt_int       -12            fmt_bytes     512B 12K 1.5M 3.2G
+//   fmt_hundredths 0.73          fmt_uptime    3d4h 1h18m 5m ?
+//   fmt_pct       87%            fmt_ipv4      192.0.2.10
+//   fmt_clock     09:05:00
+//
+// fmt_line() lays out fields in a fixed number of columns, space padded and
+// not NUL-terminated. Fields are placed back to back; when they don't fit,
+// the lowest priority ones are dropped (not cut) until the rest does, and
+// only a single remaining field is ever truncated.
+
+#define FMT_MAX             24
+#define FMT_MAX_FIELDS      16
+
+typedef enum {
+    FMT_LEFT,
+    FMT_RIGHT,
+    FMT_CENTER,
+} fmt_align_t;
+
+typedef struct {
+    const char *text;
+    int len;
+    int prio;                    // lower is dropped first
+} fmt_field_t;
+
+int fmt_int(char *out, long v);
+int fmt_hundredths(char *out, long v);      // 73 -> "0.73"
+int fmt_pct(char *out, int pct);
+int fmt_bytes(char *out, uint64_t bytes);   // 1024-based, one decimal from M up
+int fmt_uptime(char *out, long seconds);    // "?" if negative
+int fmt_clock(char *out, int h, int m, int s);
+int fmt_ipv4(char *out, const void *addr);  // network byte order, 4 bytes
+
+// Bounded copy of s (NUL-terminated, at most outlen - 1 chars); returns the
+// length copied
+int fmt_str(char *out, size_t outlen, const char *s);
+
+// printf into buf at *pos, advancing it; output past len - 1 is cut off
+// and later calls add nothing. For the text reports (export, trace,
+// message list), not the panel: this one does go through libc.
+void fmt_append(char *buf, size_t len, size_t *pos, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+// Fill cols columns of line with the fields that fit (see above); if the
+// first fields were dropped, the leading spaces of the next one are too.
+// Returns the columns used by text.
+int fmt_line(char *line, int cols, const fmt_field_t *f, int n, fmt_align_t align);
+
+// One string in cols columns, cut if longer
+int fmt_text(char *line, int cols, const char *s, fmt_align_t align);
+
+#endif // FMT_H
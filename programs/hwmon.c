@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <linux/netlink.h>
+#include "hwmon.h"
+
+// Whole small attribute (name, label) into buf, without the newline
+static int read_attr(const char *path, char *buf, size_t len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// How well a temperature input stands for the CPU: 3 package, 2 core/die
+// or SoC, 0 not a CPU sensor (NVMe, PCH, ACPI zones, ...)
+static int temp_rank(const char *chip, const char *label) {
+    if (strcmp(chip, "coretemp") == 0) {
+        return strncmp(label, "Package id", 10) == 0 ? 3 : 2;
+    }
+    if (strcmp(chip, "k10temp") == 0 || strcmp(chip, "zenpower") == 0) {
+        if (strcmp(label, "Tctl") == 0 || strcmp(label, "Tdie") == 0) {
+            return 3;
+        }
+        return strncmp(label, "Tccd", 4) == 0 ? 2 : 0;
+    }
+    if (strcmp(chip, "cpu_thermal") == 0 || strcmp(chip, "soc_thermal") == 0) {
+        return 2;
+    }
+    return 0;
+}
+
+static void add_input(hwmon_input_t *in, const char *chip, const char *label, const char *dir,
+                      const char *attr) {
+    snprintf(in->label, sizeof(in->label), "%s %s", chip, label);
+    in->src.fd = -1;
+    sample_set_path(&in->src, "%s/%s", dir, attr);
+}
+
+static void scan_device(hwmon_t *hw, const char *dir, const char *chip) {
+    char path[SAMPLE_PATH_MAX + 32], label[32];
+    int n;
+    DIR *d = opendir(dir);
+    if (!d) {
+        return;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        char tail[16];
+        if (sscanf(de->d_name, "temp%d_%15s", &n, tail) == 2 && strcmp(tail, "input") == 0) {
+            snprintf(path, sizeof(path), "%s/temp%d_label", dir, n);
+            if (read_attr(path, label, sizeof(label)) != 0) {
+                snprintf(label, sizeof(label), "temp%d", n);
+            }
+            int rank = temp_rank(chip, label);
+            if (rank == 0 || rank < hw->rank) {
+                continue;
+            }
+            if (rank > hw->rank) {
+                for (int i = 0; i < hw->ntemps; i++) {
+                    sample_close(&hw->temps[i].src);
+                }
+                hw->ntemps = 0;
+                hw->rank = rank;
+            }
+            if (hw->ntemps < HWMON_MAX_TEMPS) {
+                add_input(&hw->temps[hw->ntemps++], chip, label, dir, de->d_name);
+            }
+        } else if (sscanf(de->d_name, "fan%d_%15s", &n, tail) == 2 && strcmp(tail, "input") == 0 &&
+                   hw->nfans < HWMON_MAX_FANS) {
+            snprintf(label, sizeof(label), "fan%d", n);
+            add_input(&hw->fans[hw->nfans++], chip, label, dir, de->d_name);
+        }
+    }
+    closedir(d);
+}
+
+void hwmon_scan(hwmon_t *hw, const char *root) {
+    char dir[SAMPLE_PATH_MAX], path[SAMPLE_PATH_MAX + 8], chip[32];
+
+    for (int i = 0; i < hw->ntemps; i++) {
+        sample_close(&hw->temps[i].src);
+    }
+    for (int i = 0; i < hw->nfans; i++) {
+        sample_close(&hw->fans[i].src);
+    }
+    memset(hw, 0, sizeof(*hw));
+    hw->scanned = 1;
+
+    DIR *d = opendir(root);
+    if (!d) {
+        return;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        // Older drivers keep their attributes on the parent device
+        int len = snprintf(dir, sizeof(dir), "%s/%s/device", root, de->d_name);
+        if (len >= (int)sizeof(dir)) {
+            continue;
+        }
+        dir[len - 7] = '\0';
+        snprintf(path, sizeof(path), "%s/name", dir);
+        if (read_attr(path, chip, sizeof(chip)) != 0) {
+            dir[len - 7] = '/';
+            snprintf(path, sizeof(path), "%s/name", dir);
+            if (read_attr(path, chip, sizeof(chip)) != 0) {
+                continue;
+            }
+        }
+        scan_device(hw, dir, chip);
+    }
+    closedir(d);
+}
+
+int hwmon_cpu_temp(hwmon_t *hw) {
+    int best = -1;
+
+    for (int i = 0; i < hw->ntemps; i++) {
+        long millidegrees;
+        if (sample_read_long(&hw->temps[i].src, &millidegrees) == 0) {
+            int celsius = (int)(millidegrees / 1000);
+            // 0 or less usually means a disabled or broken sensor
+            if (celsius > 0 && celsius < 150 && celsius > best) {
+                best = celsius;
+            }
+        }
+    }
+    return best;
+}
+
+int hwmon_fan_rpm(hwmon_t *hw) {
+    int best = -1;
+
+    for (int i = 0; i < hw->nfans; i++) {
+        long rpm;
+        if (sample_read_long(&hw->fans[i].src, &rpm) == 0 && rpm >= 0 && rpm > best) {
+            best = (int)rpm;
+        }
+    }
+    return best;
+}
+
+// Kernel uevents read "action@devpath\0ACTION=action\0DEVPATH=devpath\0
+// SUBSYSTEM=...\0...", so with the header's NUL at i, SUBSYSTEM= starts at
+// 2 * i + 17. The socket filter finds i by testing each byte in turn
+// (classic BPF has no loops) and drops everything but SUBSYSTEM=hwmon in
+// the kernel: block, net or USB hot-plug never wakes the daemon. Headers
+// longer than UEVENT_SCAN_MAX are let through for hwmon_uevent_read().
+#define UEVENT_SCAN_MAX     256
+#define UEVENT_HWMON        "SUBSYSTEM=hwmon"   // 16 bytes with the NUL
+
+static int attach_hwmon_filter(int fd) {
+    static struct sock_filter prog[4 * UEVENT_SCAN_MAX + 11];
+    int ja[UEVENT_SCAN_MAX];
+    int n = 0;
+
+    for (int i = 0; i < UEVENT_SCAN_MAX; i++) {
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, i);
+        prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 2);
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_LDX | BPF_IMM, 2 * i + 17);
+        ja[i] = n;
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 0);
+    }
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+
+    // Compare 4 bytes at a time; a load past the end also drops
+    int cmp = n;
+    for (int w = 0; w < 4; w++) {
+        uint32_t word;
+        memcpy(&word, UEVENT_HWMON + 4 * w, sizeof(word));
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_IND, 4 * w);
+        prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(word), 0, 7 - 2 * w);
+    }
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+
+    for (int i = 0; i < UEVENT_SCAN_MAX; i++) {
+        prog[ja[i]].k = cmp - (ja[i] + 1);
+    }
+    struct sock_fprog fprog = { .len = (unsigned short)n, .filter = prog };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+}
+
+int hwmon_uevent_open(void) {
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = 1 };  // kernel events
+
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        return -1;
+    }
+    // Without the filter every event still arrives and is checked below
+    attach_hwmon_filter(fd);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int hwmon_uevent_read(int fd) {
+    char buf[4096];
+    struct sockaddr_nl from;
+    socklen_t fromlen;
+    ssize_t n;
+    int changed = 0;
+
+    for (;;) {
+        fromlen = sizeof(from);
+        n = recvfrom(fd, buf, sizeof(buf) - 1, 0, (struct sockaddr *)&from, &fromlen);
+        if (n <= 0) {
+            break;
+        }
+        if (from.nl_pid != 0) {
+            continue;  // only the kernel's own messages
+        }
+        buf[n] = '\0';
+        // "action@devpath\0KEY=value\0..."
+        for (char *p = buf; p < buf + n; p += strlen(p) + 1) {
+            if (strcmp(p, "SUBSYSTEM=hwmon") == 0) {
+                changed = 1;
+            }
+        }
+    }
+    return changed;
+}
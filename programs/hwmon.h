@@ -0,0 +1,56 @@
+#ifndef HWMON_H
+#define HWMON_H
+
+#include "sampler.h"
+
+// CPU temperature and fan sensors from /sys/class/hwmon.
+//
+// hwmon_scan() walks the hwmon devices once, picks the inputs to use from
+// each device's name and the temp*_label attributes, and keeps them open
+// (sampler.h), so a reading is one pread() per input. Preference for the
+// CPU temperature, best first:
+//   coretemp "Package id N", k10temp/zenpower "Tctl"/"Tdie"
+//   coretemp cores, k10temp/zenpower CCDs, cpu_thermal/soc_thermal
+// Only the best class found is kept and the hottest of its inputs is used
+// (one package sensor per socket). Every fan*_input (nct6775, it87, ...)
+// is kept, and the fastest fan is reported.
+//
+// Discovery is not repeated on its own: hwmon_uevent_open() gives a kernel
+// uevent socket that reports when a hwmon device comes or goes, for the
+// caller to rescan then. A socket filter drops other subsystems' events in
+// the kernel, so unrelated hot-plug doesn't wake the caller.
+
+#define HWMON_ROOT          "/sys/class/hwmon"
+#define HWMON_MAX_TEMPS     8
+#define HWMON_MAX_FANS      8
+
+typedef struct {
+    char label[64];              // "coretemp Package id 0"
+    sample_src_t src;
+} hwmon_input_t;
+
+typedef struct {
+    int scanned;
+    int rank;                    // class of the temperature inputs, 0 = none
+    int ntemps;
+    hwmon_input_t temps[HWMON_MAX_TEMPS];
+    int nfans;
+    hwmon_input_t fans[HWMON_MAX_FANS];
+} hwmon_t;
+
+// (Re)discover the sensors under root, closing the handles of a previous scan
+void hwmon_scan(hwmon_t *hw, const char *root);
+
+// Hottest CPU input in degrees C, -1 if none is readable
+int hwmon_cpu_temp(hwmon_t *hw);
+
+// Fastest fan in RPM, -1 if none is readable
+int hwmon_fan_rpm(hwmon_t *hw);
+
+// Non-blocking NETLINK_KOBJECT_UEVENT socket, -1 if unavailable
+int hwmon_uevent_open(void);
+
+// Drain the uevent socket; returns 1 if a hwmon device was added or removed
+int hwmon_uevent_read(int fd);
+
+#endif // HWMON_H
@@ -2,8 +2,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include "keypad.h"
 
-#define PLCM_IOCTL_GET_KEYPAD 0x0C
 
 int main() {
     int fd = open("/dev/plcm_drv", O_RDWR);
@@ -14,11 +14,11 @@ int main() {
     
     while (1) {
         int val = ioctl(fd, PLCM_IOCTL_GET_KEYPAD, 0);
-        if (val != last && (val & 0x40) != 0) {
+        if (val != last && (val & PLCM_KEYPAD_PRESSED) != 0) {
             printf("Button pressed: 0x%02X\n", val);
             fflush(stdout);
         }
-        if ((val & 0x40) == 0) last = val;
+        if ((val & PLCM_KEYPAD_PRESSED) == 0) last = val;
         usleep(50000);
     }
     
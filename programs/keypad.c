@@ -0,0 +1,107 @@
+#include <string.h>
+#include "keypad.h"
+
+#define MS(x)   ((int64_t)(x) * 1000000LL)
+
+static const char *key_names[KEY_COUNT] = {
+    [KEY_UP]    = "UP",
+    [KEY_DOWN]  = "DOWN",
+    [KEY_LEFT]  = "LEFT",
+    [KEY_RIGHT] = "RIGHT",
+};
+
+static const char *ev_names[KEYPAD_EV_COUNT] = {
+    [KEYPAD_EV_PRESS]   = "press",
+    [KEYPAD_EV_RELEASE] = "release",
+    [KEYPAD_EV_LONG]    = "long",
+    [KEYPAD_EV_REPEAT]  = "repeat",
+    [KEYPAD_EV_CHORD]   = "chord",
+};
+
+const char *keypad_key_name(keypad_key_t key) {
+    return key_names[key];
+}
+
+const char *keypad_ev_name(keypad_ev_type_t type) {
+    return ev_names[type];
+}
+
+void keypad_init(keypad_t *kp, const keypad_timing_t *timing) {
+    memset(kp, 0, sizeof(*kp));
+    kp->timing = *timing;
+    kp->key = -1;
+    kp->changed_ns = INT64_MIN / 2;  // first sample is never debounced
+}
+
+int keypad_decode(int code) {
+    if (code < 0 || (code & PLCM_KEYPAD_PRESSED) == 0) {
+        return -1;
+    }
+    switch (code & PLCM_KEYPAD_DIR_MASK) {
+        case PLCM_KEYPAD_DIR_UP:
+            return KEY_UP;
+        case PLCM_KEYPAD_DIR_DOWN:
+            return KEY_DOWN;
+        case PLCM_KEYPAD_DIR_RIGHT:
+            return KEY_RIGHT;
+        default:
+            return KEY_LEFT;
+    }
+}
+
+int keypad_active(const keypad_t *kp) {
+    return kp->key >= 0;
+}
+
+static void add_event(keypad_event_t *ev, int *n, keypad_ev_type_t type, unsigned int keys,
+                      int count, int64_t held_ns) {
+    ev[*n].type = type;
+    ev[*n].keys = keys;
+    ev[*n].count = count;
+    ev[*n].held_ns = held_ns;
+    (*n)++;
+}
+
+int keypad_feed(keypad_t *kp, int code, int64_t now_ns, keypad_event_t *ev) {
+    const keypad_timing_t *t = &kp->timing;
+    int key = keypad_decode(code);
+    int n = 0;
+
+    if (key != kp->key && now_ns - kp->changed_ns >= MS(t->debounce_ms)) {
+        if (kp->key < 0) {
+            kp->keys = KEY_BIT(key);
+            kp->pressed_ns = now_ns;
+            kp->next_repeat_ns = now_ns + MS(t->repeat_delay_ms);
+            kp->long_sent = 0;
+            add_event(ev, &n, KEYPAD_EV_PRESS, kp->keys, 0, 0);
+        } else if (key < 0) {
+            add_event(ev, &n, KEYPAD_EV_RELEASE, kp->keys, 0, now_ns - kp->pressed_ns);
+            kp->keys = 0;
+        } else if ((kp->keys | KEY_BIT(key)) != kp->keys) {
+            // Back to a key already in the chord is just the encoder
+            // switching between them again
+            kp->keys |= KEY_BIT(key);
+            add_event(ev, &n, KEYPAD_EV_CHORD, kp->keys, 0, now_ns - kp->pressed_ns);
+        }
+        kp->key = key;
+        kp->changed_ns = now_ns;
+    }
+
+    // Holding a chord doesn't long-press or repeat either key
+    if (kp->key < 0 || (kp->keys & (kp->keys - 1)) != 0) {
+        return n;
+    }
+    int64_t held = now_ns - kp->pressed_ns;
+    if (t->long_ms > 0 && !kp->long_sent && held >= MS(t->long_ms)) {
+        kp->long_sent = 1;
+        add_event(ev, &n, KEYPAD_EV_LONG, kp->keys, 0, held);
+    }
+    if (t->repeat_delay_ms > 0 && now_ns >= kp->next_repeat_ns) {
+        // Samples may come slower than the repeat rate; report all steps due
+        int64_t period = MS(t->repeat_ms > 0 ? t->repeat_ms : 1);
+        int count = 1 + (int)((now_ns - kp->next_repeat_ns) / period);
+        kp->next_repeat_ns += count * period;
+        add_event(ev, &n, KEYPAD_EV_REPEAT, kp->keys, count, held);
+    }
+    return n;
+}
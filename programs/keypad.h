@@ -0,0 +1,87 @@
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <stdint.h>
+#include "../driver/plcm_ioctl.h"  // PLCM_KEYPAD_* bits
+
+// Front-panel keypad gestures.
+//
+// PLCM_IOCTL_GET_KEYPAD returns one status byte: PLCM_KEYPAD_PRESSED is set
+// while a button is down and the PLCM_KEYPAD_DIR_MASK bits say which one.
+// The keypad encodes a single button at a time, so a chord shows up as the
+// code switching from one button straight to another while still pressed,
+// never as two bits.
+//
+// keypad_feed() takes timestamped samples of that byte and turns them into
+// events:
+//   PRESS    a button went down (sent on the first sample that shows it)
+//   RELEASE  all buttons up again
+//   LONG     held for long_ms (once per hold)
+//   REPEAT   still held: after repeat_delay_ms, then every repeat_ms
+//   CHORD    a second button joined while the first was held; no LONG or
+//            REPEAT for the rest of that hold
+// Debouncing locks the state for debounce_ms after each accepted change
+// instead of waiting for the input to settle, so a press is reported on the
+// first sample and only the chatter after it is dropped.
+
+typedef enum {
+    KEY_UP,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_COUNT
+} keypad_key_t;
+
+#define KEY_BIT(k)          (1u << (k))
+
+typedef enum {
+    KEYPAD_EV_PRESS,
+    KEYPAD_EV_RELEASE,
+    KEYPAD_EV_LONG,
+    KEYPAD_EV_REPEAT,
+    KEYPAD_EV_CHORD,
+    KEYPAD_EV_COUNT
+} keypad_ev_type_t;
+
+typedef struct {
+    keypad_ev_type_t type;
+    unsigned int keys;           // KEY_BIT() mask: one key, both for CHORD
+    int count;                   // REPEAT: steps due since the last sample
+    int64_t held_ns;             // time since the press
+} keypad_event_t;
+
+typedef struct {
+    int debounce_ms;
+    int long_ms;                 // 0 = no LONG events
+    int repeat_delay_ms;         // 0 = no REPEAT events
+    int repeat_ms;
+} keypad_timing_t;
+
+#define KEYPAD_MAX_EVENTS   4    // most one sample can produce
+
+typedef struct {
+    keypad_timing_t timing;
+    int key;                     // accepted key, -1 if none
+    unsigned int keys;           // keys of the current hold (chords add)
+    int64_t changed_ns;          // when key was last accepted
+    int64_t pressed_ns;          // start of the current hold
+    int64_t next_repeat_ns;
+    int long_sent;
+} keypad_t;
+
+void keypad_init(keypad_t *kp, const keypad_timing_t *timing);
+
+// Key held in a GET_KEYPAD status byte, -1 if none (or the ioctl failed)
+int keypad_decode(int code);
+
+const char *keypad_key_name(keypad_key_t key);
+const char *keypad_ev_name(keypad_ev_type_t type);  // "press", "repeat", ...
+
+// Feed one sample taken at now_ns (CLOCK_MONOTONIC). Stores up to
+// KEYPAD_MAX_EVENTS events in ev and returns how many.
+int keypad_feed(keypad_t *kp, int code, int64_t now_ns, keypad_event_t *ev);
+
+// 1 while a button is held
+int keypad_active(const keypad_t *kp);
+
+#endif // KEYPAD_H
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+#include "fmt.h"
+
+static const char *stage_names[LAT_STAGES] = {
+    [LAT_DETECT]  = "detect",
+    [LAT_STATE]   = "state",
+    [LAT_COLLECT] = "collect",
+    [LAT_COMPOSE] = "compose",
+    [LAT_WRITE]   = "write",
+    [LAT_TOTAL]   = "total",
+};
+
+const char *lat_stage_name(lat_stage_t stage) {
+    return stage_names[stage];
+}
+
+static int log2_bucket(uint64_t ns) {
+    int b = ns ? 63 - __builtin_clzll(ns) : 0;
+    return b < LAT_BUCKETS ? b : LAT_BUCKETS - 1;
+}
+
+void lat_hist_add(lat_hist_t *h, uint64_t ns) {
+    h->buckets[log2_bucket(ns)]++;
+    h->count++;
+    h->sum_ns += ns;
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+}
+
+uint64_t lat_hist_percentile(const lat_hist_t *h, double p) {
+    uint64_t rank = (uint64_t)(h->count * p / 100.0 + 0.999999);
+    uint64_t seen = 0;
+
+    if (h->count == 0) {
+        return 0;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint64_t upper = (2ULL << b) - 1;
+            return upper < h->max_ns ? upper : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+int lat_trace_record(lat_trace_t *t, const int64_t ts[LAT_POINTS]) {
+    for (int s = LAT_DETECT; s <= LAT_WRITE; s++) {
+        int64_t d = ts[s + 1] - ts[s];
+        lat_hist_add(&t->stage[s], d > 0 ? (uint64_t)d : 0);
+    }
+    int64_t total = ts[LAT_T_WRITTEN] - ts[LAT_T_WAKE];
+    lat_hist_add(&t->stage[LAT_TOTAL], total > 0 ? (uint64_t)total : 0);
+
+    if (t->slo_ms > 0 && total > (int64_t)t->slo_ms * 1000000LL) {
+        t->slo_misses++;
+        return 1;
+    }
+    return 0;
+}
+
+// "850ns", "12us", "3.4ms", "1.20s"
+static void format_ns(uint64_t ns, char *buf, size_t len) {
+    if (ns < 1000) {
+        snprintf(buf, len, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, len, "%lluus", (unsigned long long)(ns / 1000));
+    } else if (ns < 1000000000) {
+        snprintf(buf, len, "%.1fms", ns / 1e6);
+    } else {
+        snprintf(buf, len, "%.2fs", ns / 1e9);
+    }
+}
+
+size_t lat_trace_format(const lat_trace_t *t, char *buf, size_t len) {
+    char p50[16], p99[16], max[16], mean[16], lo[16], hi[16];
+    size_t pos = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    fmt_append(buf, len, &pos, "%-8s %8s %8s %8s %8s %8s\n", "stage", "count", "p50", "p99", "max", "mean");
+    for (int s = 0; s < LAT_STAGES; s++) {
+        const lat_hist_t *h = &t->stage[s];
+        format_ns(lat_hist_percentile(h, 50), p50, sizeof(p50));
+        format_ns(lat_hist_percentile(h, 99), p99, sizeof(p99));
+        format_ns(h->max_ns, max, sizeof(max));
+        format_ns(h->count ? h->sum_ns / h->count : 0, mean, sizeof(mean));
+        fmt_append(buf, len, &pos, "%-8s %8llu %8s %8s %8s %8s\n", stage_names[s],
+               (unsigned long long)h->count, p50, p99, max, mean);
+    }
+    if (t->slo_ms > 0) {
+        fmt_append(buf, len, &pos, "slo %dms: %llu of %llu over\n", t->slo_ms,
+               (unsigned long long)t->slo_misses, (unsigned long long)t->stage[LAT_TOTAL].count);
+    }
+
+    for (int s = 0; s < LAT_STAGES; s++) {
+        const lat_hist_t *h = &t->stage[s];
+        if (h->count == 0) {
+            continue;
+        }
+        fmt_append(buf, len, &pos, "%s:\n", stage_names[s]);
+        for (int b = 0; b < LAT_BUCKETS; b++) {
+            if (h->buckets[b] == 0) {
+                continue;
+            }
+            format_ns(b ? 1ULL << b : 0, lo, sizeof(lo));
+            format_ns(2ULL << b, hi, sizeof(hi));
+            fmt_append(buf, len, &pos, "  %8s - %-8s %llu\n", lo, hi, (unsigned long long)h->buckets[b]);
+        }
+    }
+    return pos;
+}
@@ -0,0 +1,68 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Button-to-pixel latency tracing for lcd_button_daemon.
+//
+// A button-triggered update is timestamped (CLOCK_MONOTONIC) at each stage
+// of the chain: the keypad poll wakeup, the press being recognised, the line
+// state updated, the metrics collected, the frame composed, and the write to
+// the panel completed. Each stage's duration and the end-to-end time go into
+// log2 histograms (bucket n counts [2^n, 2^(n+1)) ns, as the driver's
+// keypad_latency in debugfs), so percentiles stay cheap and memory fixed.
+// Time spent waiting for the poll itself is not included: it is up to one
+// poll interval and can't be observed from here.
+
+#define LAT_BUCKETS 32           // up to ~4.3s
+
+typedef enum {
+    LAT_DETECT,                  // poll wakeup -> press recognised
+    LAT_STATE,                   // -> line state updated
+    LAT_COLLECT,                 // -> metrics collected
+    LAT_COMPOSE,                 // -> frame composed
+    LAT_WRITE,                   // -> changed spans written to the panel
+    LAT_TOTAL,                   // poll wakeup -> written
+    LAT_STAGES
+} lat_stage_t;
+
+// Points in time of one traced update, in chain order
+typedef enum {
+    LAT_T_WAKE,
+    LAT_T_PRESS,
+    LAT_T_STATE,
+    LAT_T_COLLECTED,
+    LAT_T_COMPOSED,
+    LAT_T_WRITTEN,
+    LAT_POINTS
+} lat_point_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LAT_BUCKETS];
+} lat_hist_t;
+
+typedef struct {
+    lat_hist_t stage[LAT_STAGES];
+    int slo_ms;                  // end-to-end objective, 0 = none
+    uint64_t slo_misses;         // updates slower than slo_ms
+} lat_trace_t;
+
+void lat_hist_add(lat_hist_t *h, uint64_t ns);
+
+// Upper bound of the bucket holding the p-th percentile (0 < p <= 100)
+uint64_t lat_hist_percentile(const lat_hist_t *h, double p);
+
+// Record one update. Returns 1 if it missed the SLO.
+int lat_trace_record(lat_trace_t *t, const int64_t ts[LAT_POINTS]);
+
+const char *lat_stage_name(lat_stage_t stage);
+
+// Summary table plus the non-empty buckets of every histogram, as text.
+// Returns the length written (truncated to len - 1).
+size_t lat_trace_format(const lat_trace_t *t, char *buf, size_t len);
+
+#endif // LATENCY_H
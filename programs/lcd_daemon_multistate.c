@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -9,119 +10,593 @@
 #include <sys/ioctl.h>
 #include <sys/resource.h>
 #include <sys/file.h>
-#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
 #include <syslog.h>
-#include <ifaddrs.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <net/if.h>
-#include "network_interface_utils.h"
-
-#define PLCM_IOCTL_GET_KEYPAD   0x0C
-#define STATE_FILE_LINE1        "/var/run/lcd_line1_state"
-#define STATE_FILE_LINE2        "/var/run/lcd_cycle_state"
+#include "lcd_render.h"
+#include "lcd_state.h"
+#include "metrics.h"
+#include "screen_config.h"
+#include "latency.h"
+#include "ctl_socket.h"
+#include "keypad.h"
+#include "prom_export.h"
+#include "msgqueue.h"
+#include "alerts.h"
+#include "collector.h"
+#include "../driver/plcm_ioctl.h"
+
 #define DAEMON_PIDFILE          "/run/lcd_button_daemon.pid"
 
-#define BUTTON_LEFT  0xEF
-#define BUTTON_RIGHT 0xE7
-#define BUTTON_UP    0xC7
-#define BUTTON_DOWN  0xCF
+// Poll/refresh intervals and dwell times come from the screen config
 
-#define POLL_INTERVAL_MS 200
-#define AUTO_CYCLE_LINE1_SECONDS 10
-#define AUTO_CYCLE_LINE2_SECONDS 5
-#define INTERFACE_CHECK_INTERVAL_SECONDS 30
+// Descriptors held at once: the event fds (epoll, timers, signalfd, netlink,
+// uevent, inotify, eventfds, sockets), the control clients, the sampler
+// handles, 4 counters per NIC in the rate engine and the hwmon inputs, plus
+// headroom for syslog, the device and the export being written
+#define DAEMON_EVENT_FDS    32
+#define DAEMON_MAX_FDS      (DAEMON_EVENT_FDS + CTL_MAX_CLIENTS + 4 * NETRATE_MAX_IFS + \
+                             HWMON_MAX_TEMPS + HWMON_MAX_FANS + 64)
 
-#define MAX_IPS 10
-#define LINE1_STATES 4
+// After an accept() error such as EMFILE, the listen fd stays readable; it
+// is left out of the epoll set this long instead of spinning the loop
+#define CTL_ACCEPT_BACKOFF_MS   1000
 
-static volatile sig_atomic_t keep_running = 1;
+#define LINE1_STATES (config.nscreens)
 
-void signal_handler(int signum) {
-    keep_running = 0;
-}
+static int keep_running = 1;
+
+// Screens and timings, from LCD_CONFIG_FILE or built in
+static screen_config_t config;
 
-int count_ip_addresses() {
-    struct ifaddrs *ifaddr, *ifa;
-    int count = 0;
+// (Re)load LCD_CONFIG_FILE. A broken file keeps the screens we have; a
+// missing one means the built-in screens. Returns 1 if the config changed.
+static int load_config(void) {
+    char err[256];
 
-    if (getifaddrs(&ifaddr) == -1) {
+    if (access(LCD_CONFIG_FILE, F_OK) != 0) {
+        config = *screen_config_default();
+        return 1;
+    }
+    if (screen_config_load(&config, LCD_CONFIG_FILE, err, sizeof(err)) != 0) {
+        syslog(LOG_ERR, "%s; keeping current screens", err);
         return 0;
     }
+    syslog(LOG_INFO, "Loaded %d screens from %s", config.nscreens, LCD_CONFIG_FILE);
+    return 1;
+}
+
+int get_line2_total_states() {
+    int num_ips = count_ip_addresses();
+    // Line 2 states: Model + num_ips + Hostname = 1 + num_ips + 1
+    return 1 + num_ips + 1;
+}
+
+// Repaint the frame the previous instance last published (lcd_state.h), so
+// the panel shows something useful within milliseconds of a restart instead
+// of waiting for the first full render. The segment is updated after every
+// repaint, so this also works after a crash or SIGKILL.
+void restore_last_frame() {
+    lcd_state_t last;
+    if (lcd_state_read(&last) != 0 || last.frames == 0) {
+        return;
+    }
+
+    int fd = open("/dev/plcm_drv", O_RDWR);
+    if (fd < 0) {
+        return;
+    }
+    ioctl(fd, PLCM_IOCTL_SET_LINE, 1);
+    write(fd, last.line1, sizeof(last.line1));
+    ioctl(fd, PLCM_IOCTL_SET_LINE, 2);
+    write(fd, last.line2, sizeof(last.line2));
+    close(fd);
+}
+
+// Renderer state lives for the whole daemon run (display setup done once,
+// network counters kept in memory)
+static lcd_render_t render;
 
-    for (ifa = ifaddr; ifa != NULL && count < MAX_IPS; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == NULL)
-            continue;
+// Button-to-pixel latency of button-triggered updates
+static lat_trace_t trace;
 
-        if (!(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK))
-            continue;
+// Counters for the Prometheus export
+static prom_daemon_stats_t stats;
 
-        // Skip virtual interfaces - only count physical NICs
-        if (is_virtual_interface(ifa->ifa_name))
-            continue;
+// Line states live here; state_shm mirrors them for lcd_vitals and other
+// readers (NULL if /dev/shm is unavailable)
+static lcd_state_t state;
+static lcd_state_shm_t *state_shm;
 
-        if (ifa->ifa_addr->sa_family == AF_INET) {
-            count++;
+// /dev/plcm_drv stays open for the daemon's lifetime: keypad samples are a
+// single ioctl, and nobody else can grab the (single-open) device between
+// two of our frames. Dropped after a failed call and reopened on next use,
+// so a driver reload is picked up.
+static int dev_fd = -1;
+static int dev_warned;
+
+static int device_fd(void) {
+    if (dev_fd < 0) {
+        dev_fd = open("/dev/plcm_drv", O_RDWR | O_CLOEXEC);
+        if (dev_fd < 0) {
+            stats.device_open_errors++;
+            if (!dev_warned) {
+                syslog(LOG_WARNING, "Failed to open /dev/plcm_drv: %m");
+                dev_warned = 1;
+            }
+        } else if (dev_warned) {
+            syslog(LOG_INFO, "/dev/plcm_drv open again");
+            dev_warned = 0;
         }
     }
+    return dev_fd;
+}
 
-    freeifaddrs(ifaddr);
-    return count;
+static void device_close(void) {
+    if (dev_fd >= 0) {
+        close(dev_fd);
+        dev_fd = -1;
+    }
 }
 
-int get_line2_total_states() {
-    int num_ips = count_ip_addresses();
-    // Line 2 states: Model + num_ips + Hostname = 1 + num_ips + 1
-    return 1 + num_ips + 1;
+// Messages posted on the query socket (lcdctl). msg_showing is the message
+// each line's auto-cycle is on (0: its screens), msg_last the one it showed
+// last, so queued messages take turns.
+static msg_queue_t messages;
+static unsigned long msg_showing[2], msg_last[2];
+static char msg_text[2][MSG_TEXT_MAX + 1];   // what render.override points to
+static int msg_dirty;            // queue changed what a line should show
+static int msg_held;             // ... and msg_max_fps is holding it back
+static int64_t msg_frame_ns;     // last frame that put a message change up
+
+// What a line should show instead of its state: the newest high priority
+// message, else the message the auto-cycle is on, else NULL
+static const char *msg_wanted_text(int line) {
+    const msg_t *m = msg_alert(&messages, line);
+    if (!m) {
+        m = msg_by_id(&messages, msg_showing[line]);
+    }
+    if (!m) {
+        msg_showing[line] = 0;  // expired or cleared while shown
+        return NULL;
+    }
+    return m->text;
 }
 
-int get_state(const char *file) {
-    FILE *f = fopen(file, "r");
-    int state = 0;
-    if (f) {
-        fscanf(f, "%d", &state);
-        fclose(f);
+static int msg_changed(void) {
+    for (int line = 0; line < 2; line++) {
+        const char *want = msg_wanted_text(line);
+        const char *have = render.override[line];
+        if ((want == NULL) != (have == NULL) || (want && strcmp(want, have) != 0)) {
+            return 1;
+        }
     }
-    return state;
+    return 0;
 }
 
-void set_state(const char *file, int state, int total_states) {
-    FILE *f = fopen(file, "w");
-    if (f) {
-        fprintf(f, "%d\n", state % total_states);
-        fclose(f);
+// Auto-cycle tick on a line: a message steps in between two screens, if one
+// is queued for the line. Returns 1 if it did and the state must not move.
+static int msg_rotate(int line) {
+    if (msg_showing[line]) {
+        msg_showing[line] = 0;
+        return 0;
+    }
+    const msg_t *m = msg_next_rotation(&messages, line, msg_last[line]);
+    if (!m) {
+        return 0;
     }
+    msg_showing[line] = msg_last[line] = m->id;
+    return 1;
 }
 
 void update_display() {
-    // Call the multistate display renderer
-    int ret = system("/usr/local/bin/lcd_vitals");
-
-    if (ret == -1) {
-        // system() call itself failed (fork/exec error)
-        syslog(LOG_ERR, "Failed to execute lcd_vitals: system() error");
-    } else if (WIFEXITED(ret)) {
-        // Process exited normally, check exit code
-        int exit_code = WEXITSTATUS(ret);
-        if (exit_code != 0) {
-            syslog(LOG_WARNING, "lcd_vitals exited with code %d", exit_code);
+    if (msg_changed()) {
+        msg_frame_ns = metrics_now_ns();
+    }
+    for (int line = 0; line < 2; line++) {
+        const char *text = msg_wanted_text(line);
+        if (text) {
+            snprintf(msg_text[line], sizeof(msg_text[line]), "%s", text);
+        }
+        render.override[line] = text ? msg_text[line] : NULL;
+    }
+    msg_dirty = 0;
+    msg_held = 0;
+
+    int fd = device_fd();
+    if (fd >= 0) {
+        int ret = lcd_render_frame(&render, fd, state.line1_state, state.line2_state);
+        lat_hist_add(&stats.render, render.t_written - render.t_frame_start);
+        if (ret != 0) {
+            stats.device_write_errors++;
+            syslog(LOG_WARNING, "Failed to write frame to /dev/plcm_drv: %m");
+            device_close();
+        }
+    }
+
+    // Published even without the device, so readers still see line states
+
+    state.frames = render.frames;
+    state.frames_composed = render.frames_composed;
+    state.frames_skipped = render.frames_skipped;
+    state.bytes_sent = render.bytes_sent;
+    state.updated = time(NULL);
+    memcpy(state.line1, render.frame[0], sizeof(state.line1));
+    memcpy(state.line2, render.frame[1], sizeof(state.line2));
+    lcd_net_t net;
+    if (lcd_render_net(&net) == 0) {
+        snprintf(state.net_ifname, sizeof(state.net_ifname), "%s", net.ifname);
+        state.net_time_ns = net.last.t_ns;
+        state.net_rx_bytes = net.last.rx_bytes;
+        state.net_tx_bytes = net.last.tx_bytes;
+        state.net_rx_packets = net.last.rx_packets;
+        state.net_tx_packets = net.last.tx_packets;
+        state.net_rx_bps = (uint64_t)net.inst.rx_bits;
+        state.net_tx_bps = (uint64_t)net.inst.tx_bits;
+        state.net_rx_bps_ewma = (uint64_t)net.ewma.rx_bits;
+        state.net_tx_bps_ewma = (uint64_t)net.ewma.tx_bits;
+        state.net_rx_bps_peak = (uint64_t)net.peak.rx_bits;
+        state.net_tx_bps_peak = (uint64_t)net.peak.tx_bits;
+        state.net_rx_pps = (uint64_t)net.inst.rx_packets;
+        state.net_tx_pps = (uint64_t)net.inst.tx_packets;
+    }
+    lcd_state_publish(state_shm, &state);
+}
+
+// Threshold alerts from the screen config. While an alert with a screen is
+// active, line 1 is moved there and its auto-cycle stops (buttons still
+// work); one with blink set blinks the backlight.
+static alert_state_t alert_state[ALERT_MAX];
+static int alert_pinned;
+static int alert_blinking;
+static int backlight_on = 1;
+
+// Evaluate every rule on the latest samples. Returns 1 if an alert that
+// just went active moved line 1 to its screen.
+static int check_alerts(void) {
+    int64_t now = metrics_now_ns();
+    int moved = 0;
+
+    alert_pinned = 0;
+    alert_blinking = 0;
+    for (int i = 0; i < config.nalerts; i++) {
+        const alert_rule_t *a = &config.alerts[i];
+        alert_state_t *st = &alert_state[i];
+        int ret = alert_eval(a, st, now);
+        if (ret > 0) {
+            syslog(LOG_WARNING, "Alert %s: %s %ld %s %d", a->name, metric_desc(a->metric)->name,
+                   st->value, a->op == ALERT_ABOVE ? ">" : "<", a->threshold);
+            if (a->screen >= 0 && state.line1_state != a->screen) {
+                state.line1_state = a->screen;
+                moved = 1;
+            }
+        } else if (ret < 0) {
+            syslog(LOG_NOTICE, "Alert %s cleared: %s %ld", a->name, metric_desc(a->metric)->name,
+                   st->value);
+        }
+        if (st->active) {
+            alert_pinned |= a->screen >= 0;
+            alert_blinking |= a->blink;
+        }
+    }
+    return moved;
+}
+
+// Runs on the collector worker that samples the sensors (syslog is
+// thread-safe)
+static void log_hwmon(const hwmon_t *hw) {
+    if (hw->ntemps > 0) {
+        syslog(LOG_INFO, "CPU temperature from %s%s, %d fan(s)", hw->temps[0].label,
+               hw->ntemps > 1 ? " (and others, hottest shown)" : "", hw->nfans);
+    } else {
+        syslog(LOG_INFO, "No CPU sensor in hwmon, using thermal zones; %d fan(s)", hw->nfans);
+    }
+}
+
+static void set_backlight(int on) {
+    backlight_on = on;
+    if (device_fd() >= 0 && ioctl(dev_fd, PLCM_IOCTL_BACKLIGHT, on) < 0) {
+        device_close();
+    }
+}
+
+// Button gestures (timings from the screen config)
+static keypad_t keypad;
+static int line1_paused;         // long-press UP/DOWN: line 1 auto-cycle off
+
+enum {
+    LINE1_CHANGED = 1,
+    LINE2_CHANGED = 2,
+};
+
+// Apply one keypad event to the line states. UP/DOWN step line 1, LEFT/RIGHT
+// step line 2 and keep stepping while held; a long UP/DOWN press pauses or
+// resumes the line 1 auto-cycle, and UP+DOWN goes back to the first screens.
+// Returns the LINE*_CHANGED bits of the lines that moved.
+static int key_event(const keypad_event_t *ev) {
+    const char *how = ev->type == KEYPAD_EV_REPEAT ? "held" : "button";
+    int steps = 1;
+
+    switch (ev->type) {
+        case KEYPAD_EV_CHORD:
+            if (ev->keys != (KEY_BIT(KEY_UP) | KEY_BIT(KEY_DOWN))) {
+                return 0;
+            }
+            state.line1_state = 0;
+            state.line2_state = 0;
+            syslog(LOG_INFO, "UP+DOWN -> first screens");
+            return LINE1_CHANGED | LINE2_CHANGED;
+
+        case KEYPAD_EV_LONG:
+            if (ev->keys == KEY_BIT(KEY_UP) || ev->keys == KEY_BIT(KEY_DOWN)) {
+                line1_paused = !line1_paused;
+                syslog(LOG_INFO, "Line 1 auto-cycle %s", line1_paused ? "paused" : "resumed");
+            }
+            return 0;
+
+        case KEYPAD_EV_REPEAT:
+            steps = ev->count;
+            break;
+
+        case KEYPAD_EV_PRESS:
+            break;
+
+        default:
+            return 0;
+    }
+
+    if (ev->keys == KEY_BIT(KEY_UP) && ev->type == KEYPAD_EV_PRESS) {
+        state.line1_state = (state.line1_state - 1 + LINE1_STATES) % LINE1_STATES;
+        syslog(LOG_INFO, "UP button -> line1 state %d/%d", state.line1_state, LINE1_STATES);
+        return LINE1_CHANGED;
+    } else if (ev->keys == KEY_BIT(KEY_DOWN) && ev->type == KEYPAD_EV_PRESS) {
+        state.line1_state = (state.line1_state + 1) % LINE1_STATES;
+        syslog(LOG_INFO, "DOWN button -> line1 state %d/%d", state.line1_state, LINE1_STATES);
+        return LINE1_CHANGED;
+    } else if (ev->keys == KEY_BIT(KEY_LEFT)) {
+        steps %= state.line2_states;
+        state.line2_state = (state.line2_state - steps + state.line2_states) % state.line2_states;
+        syslog(LOG_INFO, "LEFT %s -> line2 state %d/%d", how, state.line2_state, state.line2_states);
+        return LINE2_CHANGED;
+    } else if (ev->keys == KEY_BIT(KEY_RIGHT)) {
+        state.line2_state = (state.line2_state + steps) % state.line2_states;
+        syslog(LOG_INFO, "RIGHT %s -> line2 state %d/%d", how, state.line2_state, state.line2_states);
+        return LINE2_CHANGED;
+    }
+    return 0;
+}
+
+// Event sources in the main loop (epoll_event.data.u32)
+enum {
+    EV_KEYPAD,
+    EV_REFRESH,
+    EV_CYCLE_LINE1,
+    EV_CYCLE_LINE2,
+    EV_SIGNAL,
+    EV_NETLINK,
+    EV_CONFIG,
+    EV_CTL,
+    EV_EXPORT,
+    EV_MSG,
+    EV_BLINK,
+    EV_HWMON,
+    EV_MOUNTS,
+    EV_COLLECT,
+    EV_CTL_TIMEOUT,
+    EV_CTL_CONN,                 // + slot in ctl_conns, one per client
+};
+
+#define MAX_EVENTS (EV_CTL_CONN + CTL_MAX_CLIENTS)
+
+// (Re)arm a periodic timerfd; the first expiry is one full interval from now
+static void timer_arm(int tfd, long interval_ms) {
+    struct itimerspec its;
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(tfd, 0, &its, NULL);
+}
+
+// Arm a one-shot timerfd for an absolute CLOCK_MONOTONIC time; 0 disarms
+static void timer_arm_at(int tfd, int64_t at_ns) {
+    struct itimerspec its = { { 0, 0 }, { at_ns / 1000000000, at_ns % 1000000000 } };
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int timer_open(int epfd, unsigned int tag, long interval_ms) {
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = tag };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0) {
+        close(tfd);
+        return -1;
+    }
+    timer_arm(tfd, interval_ms);
+    return tfd;
+}
+
+// Line 1 stays on each screen for that screen's dwell time
+static long line1_dwell_ms(int line1_state) {
+    return config.screens[line1_state % config.nscreens].dwell_s * 1000L;
+}
+
+// 1 if a batch of inotify events on the config directory touched the file
+static int config_touched(int ifd) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *name = strrchr(LCD_CONFIG_FILE, '/') + 1;
+    int touched = 0;
+    ssize_t n;
+
+    while ((n = read(ifd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len > 0 && strcmp(ev->name, name) == 0) {
+                touched = 1;
+            }
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+    return touched;
+}
+
+// Close the trace of a button-triggered update once the frame is out
+static void trace_update(int64_t ts[LAT_POINTS]) {
+    ts[LAT_T_COLLECTED] = render.t_frame_start + render.collect_ns;
+    ts[LAT_T_COMPOSED] = render.t_composed;
+    ts[LAT_T_WRITTEN] = render.t_written;
+    if (lat_trace_record(&trace, ts)) {
+        syslog(LOG_NOTICE, "Button update took %lldms (SLO %dms)",
+               (long long)((ts[LAT_T_WRITTEN] - ts[LAT_T_WAKE]) / 1000000), trace.slo_ms);
+    }
+}
+
+static void log_trace(void) {
+    static char buf[8192];
+    lat_trace_format(&trace, buf, sizeof(buf));
+    for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        syslog(LOG_INFO, "latency %s", line);
+    }
+}
+
+#define EXPORT_BUF_SIZE 16384
+
+// Write the Prometheus textfile, if the collector directory exists
+static void export_textfile(void) {
+    static char buf[EXPORT_BUF_SIZE];
+    static int failed;
+
+    if (access(config.export_dir, W_OK) != 0) {
+        return;
+    }
+    size_t len = prom_format(buf, sizeof(buf), &render, &stats, &trace);
+    if (prom_write_textfile(config.export_dir, buf, len) != 0) {
+        if (!failed) {
+            syslog(LOG_WARNING, "Cannot write %s/%s: %m", config.export_dir, PROM_TEXTFILE_NAME);
+        }
+        failed = 1;
+    } else {
+        failed = 0;
+    }
+}
+
+// Apply a message command from the control socket, reply into buf
+static size_t serve_msg(const msg_request_t *req, char *buf, size_t len) {
+    static const char *results[] = {
+        [MSG_ADDED]     = "added",
+        [MSG_REPLACED]  = "replaced",
+        [MSG_REFRESHED] = "refreshed",
+    };
+    int64_t now = metrics_now_ns();
+
+    switch (req->type) {
+        case MSG_REQ_POST: {
+            int ret = msg_post(&messages, req, now);
+            if (ret == MSG_DROPPED) {
+                return snprintf(buf, len, "error: queue full of higher priority messages\n");
+            }
+            return snprintf(buf, len, "ok %s\n", results[ret]);
         }
-    } else if (WIFSIGNALED(ret)) {
-        // Process killed by signal
-        syslog(LOG_WARNING, "lcd_vitals killed by signal %d", WTERMSIG(ret));
+        case MSG_REQ_CLEAR:
+            return snprintf(buf, len, "ok cleared %d\n", msg_clear(&messages, req->key));
+        default:
+            msg_expire(&messages, now);
+            return msg_list(&messages, now, buf, len);
+    }
+}
+
+// Control socket clients whose request is still coming in. Their fds are
+// in the epoll set as EV_CTL_CONN + slot; ctl_tfd fires at the earliest
+// deadline among them.
+static ctl_conn_t ctl_conns[CTL_MAX_CLIENTS];
+static int ctl_tfd = -1;
+static int ctl_accepting = 1;    // listening socket is in the epoll set
+static int64_t ctl_paused_until; // no accepting before then (accept() failed)
+
+// After control socket activity: drop clients past their deadline, arm
+// ctl_tfd for the next one, and only wait for new clients while a slot is
+// free (the others stay queued in the listen backlog) and accept() isn't
+// backing off
+static void ctl_rearm(int epfd, int lfd) {
+    int64_t now = metrics_now_ns();
+    int nfree;
+
+    int64_t next = ctl_expire(ctl_conns, CTL_MAX_CLIENTS, now, &nfree);
+    int paused = now < ctl_paused_until;
+    if (paused && (next == 0 || ctl_paused_until < next)) {
+        next = ctl_paused_until;
+    }
+    timer_arm_at(ctl_tfd, next);
+    if ((nfree > 0 && !paused) != ctl_accepting) {
+        ctl_accepting = nfree > 0 && !paused;
+        struct epoll_event qev = { .events = ctl_accepting ? EPOLLIN : 0, .data.u32 = EV_CTL };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, lfd, &qev);
+    }
+}
+
+// Take in what the client in slot sent; once its request is complete,
+// answer it: "latency", "metrics", an HTTP GET of /metrics
+// (curl --unix-socket), or a message command (msgqueue.h). Returns 1 if a
+// message command changed what the panel should show.
+static int serve_ctl(int slot) {
+    static char buf[EXPORT_BUF_SIZE + 256];  // room for the HTTP header
+    ctl_conn_t *c = &ctl_conns[slot];
+    const char *req = c->req;
+    char err[128];
+    msg_request_t mreq;
+    int parsed, changed = 0;
+    size_t len;
+
+    if (c->fd < 0 || ctl_read(c) <= 0) {
+        return 0;
+    }
+    if (strcmp(req, "latency") == 0) {
+        len = lat_trace_format(&trace, buf, sizeof(buf));
+    } else if (strcmp(req, "metrics") == 0) {
+        len = prom_format(buf, sizeof(buf), &render, &stats, &trace);
+    } else if (strncmp(req, "GET /metrics ", 13) == 0) {
+        static char body[EXPORT_BUF_SIZE];
+        size_t blen = prom_format(body, sizeof(body), &render, &stats, &trace);
+        len = snprintf(buf, sizeof(buf), "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: %zu\r\n\r\n%s", blen, body);
+        len = len < sizeof(buf) ? len : sizeof(buf) - 1;
+    } else if ((parsed = msg_parse(req, &mreq, err, sizeof(err))) < 0) {
+        len = snprintf(buf, sizeof(buf), "error: %s\n", err);
+    } else if (parsed == 0) {
+        len = serve_msg(&mreq, buf, sizeof(buf));
+        changed = msg_changed();
+    } else {
+        len = snprintf(buf, sizeof(buf), "unknown command '%s'\n", req);
     }
+    ctl_reply(c, buf, len);
+    return changed;
+}
+
+// Acknowledge an expiry so the timerfd stops being readable
+static void timer_drain(int tfd) {
+    uint64_t expirations;
+    ssize_t n = read(tfd, &expirations, sizeof(expirations));
+    (void)n;  // EAGAIN: re-armed since epoll_wait, nothing pending
 }
 
 int main() {
-    int fd;
-    int last_keypad = 0;
-    int line1_state, line2_state;
-    struct timespec sleep_time, remaining;
-    time_t last_auto_cycle_line1 = time(NULL);
-    time_t last_auto_cycle_line2 = time(NULL);
-    time_t last_display = time(NULL);
-    time_t last_interface_check = 0;  // Force initial check
-    int cached_line2_total_states = 0;
+    int64_t fast_until = 0;      // sample the keypad fast until then
+    int64_t msg_armed = 0;       // what msg_tfd is set to
+    int poll_ms;
+    int epfd, sfd;
+    int keypad_tfd, refresh_tfd, cycle1_tfd, cycle2_tfd, export_tfd, msg_tfd, blink_tfd;
+    int blink_armed = 0;
+    int config_ifd, ctl_fd;
+    int64_t ts[LAT_POINTS];
+    sigset_t mask;
+    struct epoll_event events[MAX_EVENTS];
+
+    // First thing: put the previous frame back on the panel
+    restore_last_frame();
 
     openlog("lcd_button_daemon", LOG_PID | LOG_NDELAY, LOG_DAEMON);
 
@@ -159,114 +634,442 @@ int main() {
     syslog(LOG_INFO, "LCD daemon running (PID: %d)", getpid());
 
     nice(5);
-    struct rlimit rlim = {64, 64};
-    setrlimit(RLIMIT_NOFILE, &rlim);
+    struct rlimit rlim = {DAEMON_MAX_FDS, DAEMON_MAX_FDS};
+    if (setrlimit(RLIMIT_NOFILE, &rlim) != 0) {
+        syslog(LOG_WARNING, "Cannot set the fd limit to %d: %m", DAEMON_MAX_FDS);
+    }
+
+    // Signals are delivered through a signalfd, so block their default action
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (epfd < 0 || sfd < 0) {
+        syslog(LOG_ERR, "Failed to set up event loop: %m");
+        unlink(DAEMON_PIDFILE);
+        return 1;
+    }
+    struct epoll_event sev = { .events = EPOLLIN, .data.u32 = EV_SIGNAL };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &sev);
 
-    signal(SIGTERM, signal_handler);
-    signal(SIGINT, signal_handler);
+    config = *screen_config_default();
+    load_config();
+    trace.slo_ms = config.latency_slo_ms;
+    keypad_init(&keypad, &config.keypad);
 
-    memset(&sleep_time, 0, sizeof(sleep_time));
-    sleep_time.tv_sec = 0;
-    sleep_time.tv_nsec = POLL_INTERVAL_MS * 1000000L;
+    // Resume on the screens the previous instance was showing
+    lcd_state_t restored;
+    int have_restored = lcd_state_publisher_open(&state_shm, &restored);
+    if (have_restored < 0) {
+        syslog(LOG_WARNING, "Cannot publish state in /dev/shm%s: %m", LCD_STATE_SHM_NAME);
+    }
+    state.line1_states = LINE1_STATES;
+    // The addresses are sampled by a collector worker: ask for them and give
+    // it a moment, so the restored line 2 state is taken modulo the real count
+    // (and the NICs too, for the first export)
+    count_ip_addresses();
+    metric_get(METRIC_NET);
+    collector_settle(1000);
+    state.line2_states = get_line2_total_states();
+    if (have_restored > 0 && restored.line1_state >= 0 && restored.line2_state >= 0) {
+        state.line1_state = restored.line1_state % LINE1_STATES;
+        state.line2_state = restored.line2_state % state.line2_states;
+    }
 
     // Initial display
+    lcd_render_init(&render);
+    render.cfg = &config;
+    stats.messages = &messages;
+    stats.alerts = alert_state;
     update_display();
 
-    syslog(LOG_INFO, "Polling (200ms), line1-cycle (10s), line2-cycle (5s), refresh (1s)");
+    // Each period gets its own timer, so nothing is rounded to the keypad
+    // poll or to whole seconds. The keypad itself is still sampled: the
+    // driver has no poll() support for key events.
+    poll_ms = config.poll_ms;
+    keypad_tfd = timer_open(epfd, EV_KEYPAD, poll_ms);
+    refresh_tfd = timer_open(epfd, EV_REFRESH, config.refresh_ms);
+    cycle1_tfd = timer_open(epfd, EV_CYCLE_LINE1, line1_dwell_ms(state.line1_state));
+    cycle2_tfd = timer_open(epfd, EV_CYCLE_LINE2, config.line2_dwell_s * 1000L);
+    export_tfd = timer_open(epfd, EV_EXPORT, config.export_interval_s * 1000L);  // 0: disarmed
+    msg_tfd = timer_open(epfd, EV_MSG, 0);  // one-shot, armed while messages wait
+    blink_tfd = timer_open(epfd, EV_BLINK, 0);  // armed while an alert blinks
+    if (keypad_tfd < 0 || refresh_tfd < 0 || cycle1_tfd < 0 || cycle2_tfd < 0 || export_tfd < 0 ||
+        msg_tfd < 0 || blink_tfd < 0) {
+        syslog(LOG_ERR, "Failed to create timers: %m");
+        unlink(DAEMON_PIDFILE);
+        return 1;
+    }
+
+    // Interface changes arrive on the rtnetlink socket, which the worker
+    // sampling the addresses reads (edge-triggered: we only pass the news
+    // on); without it, they are rescanned at the metric's interval
+    if (lcd_render_ifcache_fd() >= 0) {
+        struct epoll_event nev = { .events = EPOLLIN | EPOLLET, .data.u32 = EV_NETLINK };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, lcd_render_ifcache_fd(), &nev);
+    } else {
+        syslog(LOG_WARNING, "rtnetlink unavailable, rescanning interfaces every %us",
+               metric_desc(METRIC_IPS)->min_interval_ms / 1000);
+    }
+
+    // hwmon sensors are discovered once and again only on hwmon hot-plug
+    lcd_render_hwmon_notify(log_hwmon);
+    if (lcd_render_hwmon_fd() >= 0) {
+        struct epoll_event hev = { .events = EPOLLIN, .data.u32 = EV_HWMON };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, lcd_render_hwmon_fd(), &hev);
+    } else {
+        syslog(LOG_WARNING, "No uevent socket, hwmon hot-plug needs a restart: %m");
+    }
+
+    // Filesystems to show are re-read from mountinfo only when the mount
+    // table changes (POLLPRI); statvfs runs on the mounts worker
+    if (lcd_render_mounts_fd() >= 0) {
+        struct epoll_event mev = { .events = EPOLLPRI, .data.u32 = EV_MOUNTS };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, lcd_render_mounts_fd(), &mev);
+    } else {
+        syslog(LOG_WARNING, "Cannot open %s, mount changes need a restart: %m", MOUNTS_INFO_PATH);
+    }
+
+    // Metrics are sampled by the collector workers; repaint as soon as a
+    // batch is in rather than on the next tick
+    if (collector_fd() >= 0) {
+        struct epoll_event kev = { .events = EPOLLIN, .data.u32 = EV_COLLECT };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, collector_fd(), &kev);
+        if (collector_sched_error() != 0) {
+            errno = collector_sched_error();
+            syslog(LOG_WARNING, "Collector workers left on the default policy, not SCHED_BATCH: %m");
+        }
+    } else {
+        syslog(LOG_WARNING, "Cannot start collector workers, sampling in place: %m");
+    }
+
+    // Watch the directory, not the file: editors replace it by rename
+    config_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (config_ifd >= 0) {
+        char dir[sizeof(LCD_CONFIG_FILE)];
+        snprintf(dir, sizeof(dir), "%s", LCD_CONFIG_FILE);
+        *strrchr(dir, '/') = '\0';
+        if (inotify_add_watch(config_ifd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+            close(config_ifd);
+            config_ifd = -1;
+        } else {
+            struct epoll_event cev = { .events = EPOLLIN, .data.u32 = EV_CONFIG };
+            epoll_ctl(epfd, EPOLL_CTL_ADD, config_ifd, &cev);
+        }
+    }
+    if (config_ifd < 0) {
+        syslog(LOG_WARNING, "Cannot watch %s, changes need a restart: %m", LCD_CONFIG_FILE);
+    }
+
+    ctl_fd = ctl_listen(LCD_CTL_SOCKET);
+    ctl_conns_init(ctl_conns, CTL_MAX_CLIENTS);
+    if (ctl_fd >= 0) {
+        struct epoll_event qev = { .events = EPOLLIN, .data.u32 = EV_CTL };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, ctl_fd, &qev);
+        ctl_tfd = timer_open(epfd, EV_CTL_TIMEOUT, 0);  // armed while requests are read
+    } else {
+        syslog(LOG_WARNING, "Cannot listen on %s: %m", LCD_CTL_SOCKET);
+    }
+
+    syslog(LOG_INFO, "Polling (%dms, %dms when active), %d line1 screens, line2-cycle (%ds), refresh (%dms)",
+           config.poll_ms, config.poll_fast_ms, config.nscreens, config.line2_dwell_s, config.refresh_ms);
 
     while (keep_running) {
-        time_t now = time(NULL);
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_ERR, "epoll_wait failed: %m");
+            break;
+        }
+        ts[LAT_T_WAKE] = metrics_now_ns();
+
         int need_update = 0;
+        int line1_pressed = 0, line2_pressed = 0;
+        int line1_cycle = 0, line2_cycle = 0;
 
-        // Cache interface count (only recompute every 30 seconds)
-        if (now - last_interface_check >= INTERFACE_CHECK_INTERVAL_SECONDS) {
-            cached_line2_total_states = get_line2_total_states();
-            last_interface_check = now;
-        }
-        int line2_total_states = cached_line2_total_states;
-
-        // Open device for button check
-        fd = open("/dev/plcm_drv", O_RDWR);
-        if (fd >= 0) {
-            int current_keypad = ioctl(fd, PLCM_IOCTL_GET_KEYPAD, 0);
-
-            // Button detection
-            if ((current_keypad != last_keypad) && ((current_keypad & 0x40) != 0)) {
-                if (current_keypad == BUTTON_UP) {
-                    line1_state = get_state(STATE_FILE_LINE1);
-                    line1_state = (line1_state - 1 + LINE1_STATES) % LINE1_STATES;
-                    set_state(STATE_FILE_LINE1, line1_state, LINE1_STATES);
-                    last_auto_cycle_line1 = now;
-                    need_update = 1;
-                    syslog(LOG_INFO, "UP button -> line1 state %d/%d", line1_state, LINE1_STATES);
-                } else if (current_keypad == BUTTON_DOWN) {
-                    line1_state = get_state(STATE_FILE_LINE1);
-                    line1_state = (line1_state + 1) % LINE1_STATES;
-                    set_state(STATE_FILE_LINE1, line1_state, LINE1_STATES);
-                    last_auto_cycle_line1 = now;
-                    need_update = 1;
-                    syslog(LOG_INFO, "DOWN button -> line1 state %d/%d", line1_state, LINE1_STATES);
-                } else if (current_keypad == BUTTON_LEFT) {
-                    line2_state = get_state(STATE_FILE_LINE2);
-                    line2_state = (line2_state - 1 + line2_total_states) % line2_total_states;
-                    set_state(STATE_FILE_LINE2, line2_state, line2_total_states);
-                    last_auto_cycle_line2 = now;
+        for (int i = 0; i < n; i++) {
+            switch (events[i].data.u32) {
+                case EV_SIGNAL: {
+                    struct signalfd_siginfo si;
+                    while (read(sfd, &si, sizeof(si)) == sizeof(si)) {
+                        if (si.ssi_signo == SIGHUP) {
+                            // Resample everything, recount interfaces, repaint
+                            syslog(LOG_INFO, "SIGHUP, refreshing display");
+                            metrics_invalidate();
+                            state.line2_states = get_line2_total_states();
+                            render.setup_done = 0;
+                            need_update = 1;
+                        } else if (si.ssi_signo == SIGUSR1) {
+                            log_trace();
+                        } else {
+                            keep_running = 0;
+                        }
+                    }
+                    break;
+                }
+
+                case EV_NETLINK:
+                    // The worker applies the updates and posts EV_COLLECT
+                    // if the addresses changed
+                    metric_refresh(METRIC_IPS);
+                    break;
+
+                case EV_HWMON:
+                    // The worker rediscovers on its next sample, which
+                    // posts EV_COLLECT if the readings changed
+                    lcd_render_hwmon_update();
+                    break;
+
+                case EV_MOUNTS:
+                    // epoll consumed the change; the worker re-reads the
+                    // table and the disk views pick it up on their refresh
+                    lcd_render_mounts_changed();
+                    break;
+
+                case EV_COLLECT:
+                    // Only posted when a sample read differently from the
+                    // last one (collector.h), so an idle panel isn't
+                    // recomposed for nothing; the frame diff sends only
+                    // what changed. The address count may be among them.
+                    collector_drain();
+                    state.line2_states = get_line2_total_states();
                     need_update = 1;
-                    syslog(LOG_INFO, "LEFT button -> line2 state %d/%d", line2_state, line2_total_states);
-                } else if (current_keypad == BUTTON_RIGHT) {
-                    line2_state = get_state(STATE_FILE_LINE2);
-                    line2_state = (line2_state + 1) % line2_total_states;
-                    set_state(STATE_FILE_LINE2, line2_state, line2_total_states);
-                    last_auto_cycle_line2 = now;
+                    break;
+
+                case EV_CONFIG:
+                    // Picked up live; the frame diff means the panel only
+                    // changes where the new screens differ
+                    if (config_touched(config_ifd) && load_config()) {
+                        state.line1_states = LINE1_STATES;
+                        state.line1_state %= LINE1_STATES;
+                        poll_ms = config.poll_ms;
+                        fast_until = 0;
+                        timer_arm(keypad_tfd, poll_ms);
+                        timer_arm(cycle1_tfd, line1_dwell_ms(state.line1_state));
+                        timer_arm(cycle2_tfd, config.line2_dwell_s * 1000L);
+                        timer_arm(export_tfd, config.export_interval_s * 1000L);
+                        trace.slo_ms = config.latency_slo_ms;
+                        keypad.timing = config.keypad;
+                        memset(alert_state, 0, sizeof(alert_state));  // rules may have changed
+                        need_update = 1;
+                    }
+                    break;
+
+                case EV_CTL: {
+                    // The request is often there already; otherwise the
+                    // rest comes in as EV_CTL_CONN
+                    int slot = ctl_accept(ctl_fd, ctl_conns, CTL_MAX_CLIENTS, metrics_now_ns());
+                    if (slot >= 0) {
+                        struct epoll_event cev = { .events = EPOLLIN, .data.u32 = EV_CTL_CONN + slot };
+                        epoll_ctl(epfd, EPOLL_CTL_ADD, ctl_conns[slot].fd, &cev);
+                        msg_dirty |= serve_ctl(slot);
+                    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+                               errno != ECONNABORTED) {
+                        syslog(LOG_WARNING, "Control socket accept failed, pausing %dms: %m",
+                               CTL_ACCEPT_BACKOFF_MS);
+                        ctl_paused_until = metrics_now_ns() + CTL_ACCEPT_BACKOFF_MS * 1000000LL;
+                    }
+                    ctl_rearm(epfd, ctl_fd);
+                    break;
+                }
+
+                case EV_CTL_TIMEOUT:
+                    timer_drain(ctl_tfd);
+                    ctl_rearm(epfd, ctl_fd);
+                    break;
+
+                case EV_MSG:
+                    // A message expired, or a held-back change is due
+                    timer_drain(msg_tfd);
+                    msg_armed = 0;
+                    if (msg_expire(&messages, metrics_now_ns()) > 0) {
+                        msg_dirty |= msg_changed();
+                    }
+                    break;
+
+                case EV_EXPORT:
+                    timer_drain(export_tfd);
+                    export_textfile();
+                    break;
+
+                case EV_CYCLE_LINE1:
+                    timer_drain(cycle1_tfd);
+                    line1_cycle = !line1_paused && !alert_pinned;
+                    break;
+
+                case EV_BLINK:
+                    timer_drain(blink_tfd);
+                    set_backlight(!backlight_on);
+                    break;
+
+                case EV_CYCLE_LINE2:
+                    timer_drain(cycle2_tfd);
+                    line2_cycle = 1;
+                    break;
+
+                case EV_REFRESH:
+                    timer_drain(refresh_tfd);
                     need_update = 1;
-                    syslog(LOG_INFO, "RIGHT button -> line2 state %d/%d", line2_state, line2_total_states);
+                    break;
+
+                case EV_KEYPAD: {
+                    timer_drain(keypad_tfd);
+
+                    if (device_fd() < 0) {
+                        break;
+                    }
+                    int current_keypad = ioctl(dev_fd, PLCM_IOCTL_GET_KEYPAD, 0);
+                    if (current_keypad < 0) {
+                        stats.keypad_read_errors++;
+                        device_close();
+                    }
+
+                    keypad_event_t kev[KEYPAD_MAX_EVENTS];
+                    int64_t now = metrics_now_ns();
+                    int nkev = keypad_feed(&keypad, current_keypad, now, kev);
+
+                    // Sample fast while the keypad is in use, so repeats and
+                    // the next press are quick; back to the idle rate once it
+                    // has been left alone for poll_active seconds
+                    if (nkev > 0 || keypad_active(&keypad)) {
+                        fast_until = now + config.poll_active_s * 1000000000LL;
+                    }
+                    int want_ms = now < fast_until ? config.poll_fast_ms : config.poll_ms;
+                    if (want_ms != poll_ms) {
+                        poll_ms = want_ms;
+                        timer_arm(keypad_tfd, poll_ms);
+                        syslog(LOG_DEBUG, "Keypad poll %dms", poll_ms);
+                    }
+                    for (int k = 0; k < nkev; k++) {
+                        stats.keypad_events[kev[k].type]++;
+                        int changed = key_event(&kev[k]);
+                        if (changed && !line1_pressed && !line2_pressed) {
+                            ts[LAT_T_PRESS] = now;
+                        }
+                        line1_pressed |= (changed & LINE1_CHANGED) != 0;
+                        line2_pressed |= (changed & LINE2_CHANGED) != 0;
+                    }
+                    break;
                 }
-            }
 
-            if ((current_keypad & 0x40) == 0) {
-                last_keypad = current_keypad;
+                default:
+                    if (events[i].data.u32 >= EV_CTL_CONN) {
+                        msg_dirty |= serve_ctl(events[i].data.u32 - EV_CTL_CONN);
+                        ctl_rearm(epfd, ctl_fd);
+                    }
+                    break;
             }
-
-            close(fd);
         }
 
-        // Auto-cycle line 1 (every 10 seconds)
-        if (!need_update && (now - last_auto_cycle_line1) >= AUTO_CYCLE_LINE1_SECONDS) {
-            line1_state = get_state(STATE_FILE_LINE1);
-            line1_state = (line1_state + 1) % LINE1_STATES;
-            set_state(STATE_FILE_LINE1, line1_state, LINE1_STATES);
-            last_auto_cycle_line1 = now;
+        // A button press restarts that line's auto-cycle period and wins
+        // over a cycle that expired in the same wakeup; pressing also takes
+        // a rotating message off the line
+        if (line1_pressed) {
+            msg_showing[0] = 0;
+            timer_arm(cycle1_tfd, line1_dwell_ms(state.line1_state));
+            need_update = 1;
+        } else if (line1_cycle) {
+            if (!msg_rotate(0)) {
+                state.line1_state = (state.line1_state + 1) % LINE1_STATES;
+                syslog(LOG_DEBUG, "Auto-cycle line1 -> state %d/%d", state.line1_state, LINE1_STATES);
+            }
+            timer_arm(cycle1_tfd, line1_dwell_ms(state.line1_state));
             need_update = 1;
-            syslog(LOG_DEBUG, "Auto-cycle line1 -> state %d/%d", line1_state, LINE1_STATES);
         }
 
-        // Auto-cycle line 2 (every 5 seconds)
-        if (!need_update && (now - last_auto_cycle_line2) >= AUTO_CYCLE_LINE2_SECONDS) {
-            line2_state = get_state(STATE_FILE_LINE2);
-            line2_state = (line2_state + 1) % line2_total_states;
-            set_state(STATE_FILE_LINE2, line2_state, line2_total_states);
-            last_auto_cycle_line2 = now;
+        if (line2_pressed) {
+            msg_showing[1] = 0;
+            timer_arm(cycle2_tfd, config.line2_dwell_s * 1000L);
+            need_update = 1;
+        } else if (line2_cycle) {
+            if (!msg_rotate(1)) {
+                state.line2_state = (state.line2_state + 1) % state.line2_states;
+                syslog(LOG_DEBUG, "Auto-cycle line2 -> state %d/%d", state.line2_state, state.line2_states);
+            }
             need_update = 1;
-            syslog(LOG_DEBUG, "Auto-cycle line2 -> state %d/%d", line2_state, line2_total_states);
         }
 
-        // Display refresh (every 1 second for system stats)
-        if (!need_update && (now - last_display) >= 1) {
-            need_update = 1;
+        // Message changes ride along with any other repaint; on their own
+        // they get at most msg_max_fps frames a second, however often a
+        // producer posts
+        int64_t msg_due = msg_frame_ns + 1000000000LL / config.msg_max_fps;
+        if (msg_dirty && !need_update) {
+            if (ts[LAT_T_WAKE] >= msg_due) {
+                need_update = 1;
+            } else if (!msg_held) {
+                msg_held = 1;
+                stats.msg_frames_deferred++;
+            }
+        }
+
+        // Alerts are checked with every repaint (so at least every
+        // refresh_ms), on the samples the frame takes anyway; a newly raised
+        // one takes line 1 off a rotating message too
+        if (need_update && check_alerts()) {
+            msg_showing[0] = 0;
+        }
+        if (alert_blinking != blink_armed) {
+            blink_armed = alert_blinking;
+            timer_arm(blink_tfd, blink_armed ? config.blink_ms : 0);
+            if (!blink_armed && !backlight_on) {
+                set_backlight(1);
+            }
         }
 
-        if (need_update) {
+        // One repaint per wakeup, however many sources fired; the refresh
+        // interval counts from the last repaint
+        if (need_update && keep_running) {
+            ts[LAT_T_STATE] = metrics_now_ns();
             update_display();
-            last_display = now;
+            if (line1_pressed || line2_pressed) {
+                trace_update(ts);
+            }
+            timer_arm(refresh_tfd, config.refresh_ms);
         }
 
-        while (clock_nanosleep(CLOCK_MONOTONIC, 0, &sleep_time, &remaining) != 0) {
-            sleep_time = remaining;
+        // Wake for the next expiry, or when a held-back change may go up
+        int64_t msg_wake = msg_next_expiry(&messages);
+        if (msg_dirty && (msg_wake == 0 || msg_due < msg_wake)) {
+            msg_wake = msg_due;
+        }
+        if (msg_wake != msg_armed) {
+            timer_arm_at(msg_tfd, msg_wake);
+            msg_armed = msg_wake;
         }
-        sleep_time.tv_sec = 0;
-        sleep_time.tv_nsec = POLL_INTERVAL_MS * 1000000L;
     }
 
+    close(keypad_tfd);
+    close(refresh_tfd);
+    close(cycle1_tfd);
+    close(cycle2_tfd);
+    close(export_tfd);
+    close(msg_tfd);
+    close(blink_tfd);
+    if (config_ifd >= 0) {
+        close(config_ifd);
+    }
+    if (ctl_fd >= 0) {
+        int nfree;
+        ctl_expire(ctl_conns, CTL_MAX_CLIENTS, INT64_MAX, &nfree);  // drop unfinished requests
+        close(ctl_tfd);
+        close(ctl_fd);
+        unlink(LCD_CTL_SOCKET);
+    }
+    close(sfd);
+    close(epfd);
+
+    if (!backlight_on) {
+        set_backlight(1);
+    }
+    device_close();
+    lcd_state_publisher_close(state_shm);
     unlink(DAEMON_PIDFILE);
     syslog(LOG_INFO, "LCD daemon stopped");
     closelog();
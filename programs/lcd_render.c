@@ -0,0 +1,871 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/statvfs.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "network_interface_utils.h"
+#include "lcd_render.h"
+#include "sampler.h"
+#include "netlink_cache.h"
+#include "metrics.h"
+#include "netrate.h"
+#include "screen_config.h"
+#include "hwmon.h"
+#include "mounts.h"
+#include "collector.h"
+#include "fmt.h"
+#include "../driver/plcm_ioctl.h"
+
+#define READ_RETRIES    100
+
+// Persistent /proc and /sys handles, re-read with pread() when a metric is due
+static sample_src_t src_loadavg = SAMPLE_SRC_INIT("/proc/loadavg");
+static sample_src_t src_meminfo = SAMPLE_SRC_INIT("/proc/meminfo");
+static sample_src_t src_thermal[] = {
+    SAMPLE_SRC_INIT("/sys/class/thermal/thermal_zone0/temp"),
+    SAMPLE_SRC_INIT("/sys/class/thermal/thermal_zone1/temp"),
+    SAMPLE_SRC_INIT("/sys/class/thermal/thermal_zone2/temp"),
+};
+// hwmon sensors, discovered on first use and again when the uevent socket
+// reports a hwmon device coming or going. Only the thread sampling the
+// temperature and fans (the collector worker) touches them; the uevent
+// side just flags a rescan.
+static hwmon_t hwmon;
+static int hwmon_rescan;
+static void (*hwmon_notify)(const hwmon_t *hw);
+static int uevent_fd = -1;
+static int uevent_state = 0;  // 0 not opened yet, 1 open, -1 unavailable
+
+static hwmon_t *hwmon_get(void) {
+    if (!hwmon.scanned || __atomic_exchange_n(&hwmon_rescan, 0, __ATOMIC_ACQ_REL)) {
+        hwmon_scan(&hwmon, HWMON_ROOT);
+        if (hwmon_notify) {
+            hwmon_notify(&hwmon);
+        }
+    }
+    return &hwmon;
+}
+
+void lcd_render_hwmon_notify(void (*fn)(const hwmon_t *hw)) {
+    hwmon_notify = fn;
+}
+
+int lcd_render_hwmon_fd(void) {
+    if (uevent_state == 0) {
+        uevent_fd = hwmon_uevent_open();
+        uevent_state = uevent_fd >= 0 ? 1 : -1;
+    }
+    return uevent_fd;
+}
+
+int lcd_render_hwmon_update(void) {
+    if (uevent_fd < 0 || !hwmon_uevent_read(uevent_fd)) {
+        return 0;
+    }
+    __atomic_store_n(&hwmon_rescan, 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// A mounts round changed something: have {disk_used} re-read the root
+// rather than wait out its interval (the first round in particular)
+static void mounts_updated(void) {
+    collector_request(METRIC_DISK_USED);
+}
+
+// Filesystem usage from the mounts worker; statvfs("/") in place only if
+// the worker can't be started
+static int mounts_get(mounts_snapshot_t *snap) {
+    mounts_notify(mounts_updated);
+    if (mounts_start() != 0) {
+        return -1;
+    }
+    mounts_snapshot(snap);
+    return 0;
+}
+
+int lcd_render_mounts(mounts_snapshot_t *snap) {
+    return mounts_get(snap);
+}
+
+void lcd_render_settle(int timeout_ms) {
+    int64_t end = metrics_now_ns() + (int64_t)timeout_ms * 1000000LL;
+
+    collector_settle(timeout_ms);
+    int left_ms = (int)((end - metrics_now_ns()) / 1000000LL);
+    if (left_ms > 0 && mounts_wait(left_ms) == 0) {
+        // The first round has {disk_used} sampled again
+        left_ms = (int)((end - metrics_now_ns()) / 1000000LL);
+        collector_settle(left_ms > 0 ? left_ms : 0);
+    }
+}
+
+int lcd_render_mounts_fd(void) {
+    return mounts_fd();
+}
+
+void lcd_render_mounts_changed(void) {
+    mounts_changed();
+}
+
+// Interface/address cache kept current over rtnetlink; the getifaddrs() scan
+// below is only used if the netlink socket can't be opened. Opened once by
+// whoever asks first (the daemon wants the fd at startup); reading it, which
+// can mean a full re-dump, happens on the collector worker sampling
+// METRIC_IPS, under the lock only so other callers stay safe.
+static nl_cache_t ifcache = { .fd = -1 };
+static int ifcache_state = 0;  // 0 not opened yet, 1 open, -1 unavailable
+static int ifcache_fd = -1;    // as first opened
+static pthread_once_t ifcache_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t ifcache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void ifcache_open(void) {
+    ifcache_state = nl_cache_open(&ifcache) == 0 ? 1 : -1;
+    ifcache_fd = ifcache_state > 0 ? nl_cache_fd(&ifcache) : -1;
+}
+
+// Called with ifcache_mutex held, after ifcache_open(). A reopened socket
+// is not the one the daemon watches; until a restart, changes are then
+// picked up at METRIC_IPS's interval.
+static nl_cache_t *ifcache_get(void) {
+    if (ifcache_state == 0) {
+        ifcache_state = nl_cache_open(&ifcache) == 0 ? 1 : -1;
+    }
+    if (ifcache_state < 0) {
+        return NULL;
+    }
+    if (nl_cache_process(&ifcache) < 0) {
+        nl_cache_close(&ifcache);
+        ifcache_state = 0;  // reopen and re-dump on the next call
+        return NULL;
+    }
+    return &ifcache;
+}
+
+int lcd_render_ifcache_fd(void) {
+    pthread_once(&ifcache_once, ifcache_open);
+    return ifcache_fd;
+}
+
+// Seqlock publication (as in mounts.c) of what the workers sample for the
+// renderer: the line 2 addresses and the RX/TX view
+static void seq_publish(uint32_t *seq, void *pub, const void *src, size_t len) {
+    uint32_t s = *seq;
+
+    __atomic_store_n(seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(pub, src, len);
+    __atomic_store_n(seq, s + 2, __ATOMIC_RELEASE);
+}
+
+// Consistent copy of pub into dst; returns -1 (dst unusable) if the writer
+// kept getting in the way
+static int seq_read(const uint32_t *seq, const void *pub, void *dst, size_t len) {
+    for (int i = 0; i < READ_RETRIES; i++) {
+        uint32_t s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (s & 1) {
+            continue;  // Writer in progress
+        }
+        memcpy(dst, pub, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(seq, __ATOMIC_RELAXED) == s) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+typedef struct {
+    int count;
+    ip_info_t ips[LCD_MAX_IPS];
+} ip_list_t;
+
+static ip_list_t ips_pub;
+static uint32_t ips_seq;
+
+typedef struct {
+    ip_info_t *ips;
+    int max_ips;
+    int count;
+} collect_arg_t;
+
+static int collect_one(const nl_link_t *link, const nl_addr_t *addr, void *arg) {
+    collect_arg_t *ca = arg;
+    ip_info_t *ip = &ca->ips[ca->count];
+    const char *name = addr->label[0] ? addr->label : link->ifname;
+
+    strncpy(ip->ifname, name, sizeof(ip->ifname) - 1);
+    ip->ifname[sizeof(ip->ifname) - 1] = '\0';
+    fmt_ipv4(ip->ip, &addr->addr);
+    return ++ca->count >= ca->max_ips;
+}
+
+// Active interface for the RX/TX view (counters are read by netrate.c)
+static sample_src_t src_net_operstate = SAMPLE_SRC_INIT("");
+
+int collect_ip_addresses(ip_info_t *ips, int max_ips) {
+    struct ifaddrs *ifaddr, *ifa;
+    int count = 0;
+
+    pthread_once(&ifcache_once, ifcache_open);
+    pthread_mutex_lock(&ifcache_mutex);
+    nl_cache_t *cache = ifcache_get();
+    if (cache) {
+        collect_arg_t ca = { ips, max_ips, 0 };
+        if (max_ips > 0) {
+            nl_cache_for_each_shown(cache, collect_one, &ca);
+        }
+        pthread_mutex_unlock(&ifcache_mutex);
+        return ca.count;
+    }
+    pthread_mutex_unlock(&ifcache_mutex);
+
+    if (getifaddrs(&ifaddr) == -1) {
+        return 0;
+    }
+
+    for (ifa = ifaddr; ifa != NULL && count < max_ips; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL)
+            continue;
+
+        if (!(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK))
+            continue;
+
+        // Skip virtual interfaces - only show physical NICs
+        if (is_virtual_interface(ifa->ifa_name))
+            continue;
+
+        if (ifa->ifa_addr->sa_family == AF_INET) {
+            struct sockaddr_in *addr = (struct sockaddr_in *)ifa->ifa_addr;
+
+            strncpy(ips[count].ifname, ifa->ifa_name, sizeof(ips[count].ifname) - 1);
+            ips[count].ifname[sizeof(ips[count].ifname) - 1] = '\0';
+
+            fmt_ipv4(ips[count].ip, &addr->sin_addr);
+            count++;
+        }
+    }
+
+    freeifaddrs(ifaddr);
+    return count;
+}
+
+int lcd_render_sample_ips(void) {
+    ip_list_t list;
+
+    // Zeroed, so a list that reads the same compares equal to the last one
+    memset(&list, 0, sizeof(list));
+    list.count = collect_ip_addresses(list.ips, LCD_MAX_IPS);
+    if (memcmp(&list, &ips_pub, sizeof(list)) != 0) {
+        collector_changed();  // same count, other addresses
+    }
+    seq_publish(&ips_seq, &ips_pub, &list, sizeof(list));
+    return list.count;
+}
+
+// Addresses as last published, requesting a new sample when due
+static const ip_list_t *ips_get(void) {
+    static __thread ip_list_t last;  // last consistent copy, per reader
+    ip_list_t list;
+
+    metric_get(METRIC_IPS);
+    if (seq_read(&ips_seq, &ips_pub, &list, sizeof(list)) == 0) {
+        last = list;
+    }
+    return &last;
+}
+
+int count_ip_addresses(void) {
+    return ips_get()->count;
+}
+
+void get_hostname(char *buf, size_t buflen) {
+    if (gethostname(buf, buflen) != 0) {
+        snprintf(buf, buflen, "Unknown Host");
+    }
+    buf[buflen - 1] = '\0';
+}
+
+int get_cpu_temp(void) {
+    int temp = hwmon_cpu_temp(hwmon_get());
+    if (temp >= 0) {
+        return temp;
+    }
+
+    // No CPU sensor in hwmon: try the thermal zones, skip invalid readings
+    for (size_t i = 0; i < sizeof(src_thermal) / sizeof(src_thermal[0]); i++) {
+        long temp_millidegrees;
+        if (sample_read_long(&src_thermal[i], &temp_millidegrees) == 0) {
+            int temp_celsius = (int)(temp_millidegrees / 1000);
+            // Skip invalid readings (0 or negative usually means disabled/broken sensor)
+            if (temp_celsius > 0 && temp_celsius < 150) {
+                return temp_celsius;
+            }
+        }
+    }
+    return -1;  // Not available
+}
+
+int get_fan_rpm(void) {
+    return hwmon_fan_rpm(hwmon_get());
+}
+
+int get_disk_usage(void) {
+    mounts_snapshot_t snap;
+    if (mounts_get(&snap) == 0) {
+        // Never waits for the worker: nothing until it has statvfs'd "/"
+        // (the round that does re-requests this), nothing while that hangs
+        for (int i = 0; i < snap.n; i++) {
+            const mount_usage_t *m = &snap.mounts[i];
+            if (strcmp(m->path, "/") == 0) {
+                return m->stalled || m->stale ? -1 : m->used_pct;
+            }
+        }
+        return -1;
+    }
+
+    struct statvfs stat;
+    if (statvfs("/", &stat) != 0) {
+        return -1;
+    }
+    unsigned long total = stat.f_blocks * stat.f_frsize;
+    unsigned long avail = stat.f_bavail * stat.f_frsize;
+    unsigned long used = total - avail;
+    return (int)((used * 100) / total);
+}
+
+int get_fullest_disk(int n, int top, char *buf, size_t buflen) {
+    mounts_snapshot_t snap;
+    int order[MOUNTS_MAX], count = 0;
+
+    if (mounts_get(&snap) != 0) {
+        return 0;
+    }
+    // Stalled mounts first, then by fill level
+    for (int i = 0; i < snap.n; i++) {
+        const mount_usage_t *m = &snap.mounts[i];
+        if (!m->stalled && (m->used_pct < 0 || m->stale)) {
+            continue;
+        }
+        int k = count++;
+        for (; k > 0; k--) {
+            const mount_usage_t *o = &snap.mounts[order[k - 1]];
+            if (o->stalled > m->stalled || (o->stalled == m->stalled && o->used_pct >= m->used_pct)) {
+                break;
+            }
+            order[k] = order[k - 1];
+        }
+        order[k] = i;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (count > top) {
+        count = top;
+    }
+
+    const mount_usage_t *m = &snap.mounts[order[n % count]];
+    const char *name = m->path;
+    if (strlen(name) > 12 && strrchr(name, '/')[1] != '\0') {
+        name = strrchr(name, '/') + 1;  // "/srv/captures/ring0" -> "ring0"
+    }
+    char state[FMT_MAX];
+    if (m->stalled) {
+        fmt_str(state, sizeof(state), "hung");
+    } else {
+        fmt_pct(state, m->used_pct);
+    }
+    int len = fmt_str(buf, buflen - 1, name);
+    buf[len++] = ' ';
+    fmt_str(buf + len, buflen - len, state);
+    return 1;
+}
+
+long get_uptime_seconds(void) {
+    // CLOCK_BOOTTIME is what /proc/uptime reports, without the read
+    struct timespec ts;
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) != 0) {
+        return -1;
+    }
+    return (long)ts.tv_sec;
+}
+
+void format_uptime(long uptime_seconds, char *buf, size_t buflen) {
+    char tmp[FMT_MAX];
+
+    fmt_uptime(tmp, uptime_seconds);
+    fmt_str(buf, buflen, tmp);
+}
+
+void get_uptime_str(char *buf, size_t buflen) {
+    format_uptime(get_uptime_seconds(), buf, buflen);
+}
+
+int get_process_count(void) {
+    DIR *dir = opendir("/proc");
+    if (!dir) return -1;
+
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type == DT_DIR) {
+            // Check if directory name is numeric (PID)
+            char *endptr;
+            strtol(entry->d_name, &endptr, 10);
+            if (*endptr == '\0') {
+                count++;
+            }
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+int get_load_avg(void) {
+    char data[128];
+    char *endptr;
+
+    if (sample_read(&src_loadavg, data, sizeof(data)) <= 0) return -1;
+    double load1 = strtod(data, &endptr);
+    if (endptr == data) return -1;
+    return (int)(load1 * 100 + 0.5);
+}
+
+int get_mem_usage(void) {
+    char data[4096];
+    unsigned long mem_total = 0, mem_available = 0;
+
+    if (sample_read(&src_meminfo, data, sizeof(data)) <= 0) return -1;
+    sample_field_ulong(data, "MemTotal:", &mem_total);
+    sample_field_ulong(data, "MemAvailable:", &mem_available);
+
+    if (mem_total == 0 || mem_available == 0) return -1;
+    return 100 - (mem_available * 100 / mem_total);
+}
+
+int get_swap_usage(void) {
+    char data[4096];
+    unsigned long swap_total = 0, swap_free = 0;
+
+    if (sample_read(&src_meminfo, data, sizeof(data)) <= 0) return -1;
+    sample_field_ulong(data, "SwapTotal:", &swap_total);
+    sample_field_ulong(data, "SwapFree:", &swap_free);
+
+    if (swap_total == 0) return -1;  // No swap configured
+    return 100 - (swap_free * 100 / swap_total);
+}
+
+// 1 if the interface's operstate reads "up"
+static int interface_is_up(sample_src_t *src) {
+    char state[16];
+    return sample_read(src, state, sizeof(state)) > 0 && strncmp(state, "up", 2) == 0;
+}
+
+// Physical NICs, all sampled together by the worker that owns METRIC_NET
+// (the RX/TX view shows the active one, the export all of them). The
+// rate engine's table is only ever touched there; readers copy the
+// published set.
+#define NET_RESCAN_MS   30000
+
+typedef struct {
+    int n;
+    int active;                  // index of the RX/TX view's NIC, -1 none
+    lcd_net_t ifs[NETRATE_MAX_IFS];
+} net_list_t;
+
+static net_list_t nets_pub;
+static uint32_t nets_seq;
+static char net_names[NETRATE_MAX_IFS][IFNAMSIZ];
+static int net_count;
+static char active_if_name[IFNAMSIZ];
+static int64_t net_scanned_ns;
+
+static void net_add(const char *name) {
+    int i = net_count < NETRATE_MAX_IFS ? net_count++ : NETRATE_MAX_IFS - 1;
+
+    fmt_str(net_names[i], IFNAMSIZ, name);
+}
+
+// Re-read the NIC list; unless keep_active, also pick the first one that is
+// up for the RX/TX view. The active NIC is always on the list (in place of
+// the last one if there are more than the engine holds).
+static void scan_nics(int keep_active) {
+    int have_active = 0;
+
+    net_count = 0;
+    if (!keep_active) {
+        active_if_name[0] = '\0';
+    }
+    DIR *net_dir = opendir("/sys/class/net");
+    if (net_dir) {
+        struct dirent *entry;
+        while ((entry = readdir(net_dir)) != NULL) {
+            // Skip special entries (., ..) and virtual interfaces - only
+            // monitor physical NICs
+            if (entry->d_name[0] == '.' || is_virtual_interface(entry->d_name)) {
+                continue;
+            }
+            int is_active;
+            if (keep_active) {
+                is_active = strcmp(entry->d_name, active_if_name) == 0;
+            } else {
+                is_active = !active_if_name[0] &&
+                            sample_set_path(&src_net_operstate, "/sys/class/net/%s/operstate",
+                                            entry->d_name) == 0 &&
+                            interface_is_up(&src_net_operstate);
+                if (is_active) {
+                    fmt_str(active_if_name, sizeof(active_if_name), entry->d_name);
+                }
+            }
+            if (net_count < NETRATE_MAX_IFS || (is_active && !have_active)) {
+                net_add(entry->d_name);
+            }
+            have_active |= is_active;
+        }
+        closedir(net_dir);
+    }
+    if (!keep_active && !active_if_name[0]) {
+        sample_close(&src_net_operstate);
+    }
+}
+
+void get_network_rates(char *buf, size_t buflen) {
+    int64_t now = metrics_now_ns();
+    net_list_t list;
+    const lcd_net_t *active = NULL;
+
+    // Stay on the interface we used last time while it is still up; rescan
+    // /sys/class/net when it went down or disappeared, and every
+    // NET_RESCAN_MS for NICs that came or went
+    int active_up = active_if_name[0] != '\0' && interface_is_up(&src_net_operstate);
+    if (!active_up || now - net_scanned_ns >= NET_RESCAN_MS * 1000000LL) {
+        scan_nics(active_up);
+        net_scanned_ns = now;
+    }
+
+    list.n = 0;
+    list.active = -1;
+    for (int i = 0; i < net_count; i++) {
+        int is_active = strcmp(net_names[i], active_if_name) == 0;
+        netrate_if_t *nif = netrate_if(net_names[i]);
+        if (netrate_sample(nif) != 0) {
+            continue;
+        }
+        lcd_net_t *net = &list.ifs[list.n];
+        memcpy(net->ifname, nif->ifname, sizeof(net->ifname));
+        net->last = *netrate_last(nif);
+        net->inst = nif->inst;
+        net->ewma = nif->ewma;
+        net->peak = nif->peak;
+        // No rate yet (first sample, or first after a counter reset)
+        net->have_rate = nif->have_rate && nif->count > 1;
+        net->resets = nif->resets;
+        if (is_active) {
+            list.active = list.n;
+            active = net;
+        }
+        list.n++;
+    }
+    seq_publish(&nets_seq, &nets_pub, &list, sizeof(list));
+
+    if (!active_if_name[0]) {
+        fmt_str(buf, buflen, "No Network");
+        return;
+    }
+    if (!active) {
+        fmt_str(buf, buflen, "Stats N/A");
+        return;
+    }
+
+    // Show zero until the next sample gives an interval
+    uint64_t rx_rate = active->have_rate ? (uint64_t)(active->inst.rx_bits / 8) : 0;
+    uint64_t tx_rate = active->have_rate ? (uint64_t)(active->inst.tx_bits / 8) : 0;
+
+    // "RX:1.5M TX:12K"
+    char text[2 * FMT_MAX + 8], *p = text;
+    memcpy(p, "RX:", 3);
+    p += 3;
+    p += fmt_bytes(p, rx_rate);
+    memcpy(p, " TX:", 4);
+    p += 4;
+    fmt_bytes(p, tx_rate);
+    fmt_str(buf, buflen, text);
+}
+
+// NICs as last published
+static const net_list_t *nets_get(void) {
+    static __thread net_list_t last;  // last consistent copy, per reader
+    net_list_t list;
+
+    if (seq_read(&nets_seq, &nets_pub, &list, sizeof(list)) == 0) {
+        last = list;
+    }
+    return &last;
+}
+
+int lcd_render_net(lcd_net_t *out) {
+    const net_list_t *list = nets_get();
+
+    if (list->active < 0 || list->active >= list->n) {
+        return -1;
+    }
+    *out = list->ifs[list->active];
+    return 0;
+}
+
+int lcd_render_nets(lcd_net_t *out, int max) {
+    const net_list_t *list = nets_get();
+    int n = list->n < max ? list->n : max;
+
+    memcpy(out, list->ifs, n * sizeof(*out));
+    return n;
+}
+
+void lcd_render_init(lcd_render_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->cfg = screen_config_default();
+}
+
+static int eval_metric_int(metric_id_t id, char *buf) {
+    const metric_value_t *m = metric_get(id);
+    if (!m->valid || m->stale) {
+        return 0;
+    }
+    fmt_int(buf, m->value);  // buf holds FMT_MAX
+    return 1;
+}
+
+// Template variables; only called for variables the current screen uses,
+// and each metric is only re-sampled once its refresh interval passed
+static int eval_var_sample(screen_var_t var, char *buf, size_t buflen, void *ctx) {
+    lcd_render_t *r = ctx;
+    const metric_value_t *m;
+
+    switch (var) {
+        case SCREEN_VAR_LOAD1:
+            m = metric_get(METRIC_LOAD1);
+            if (!m->valid || m->stale) {
+                return 0;
+            }
+            fmt_hundredths(buf, m->value);
+            return 1;
+        case SCREEN_VAR_MEM_USED:
+            return eval_metric_int(METRIC_MEM_USED, buf);
+        case SCREEN_VAR_CPU_TEMP:
+            return eval_metric_int(METRIC_CPU_TEMP, buf);
+        case SCREEN_VAR_DISK_USED:
+            return eval_metric_int(METRIC_DISK_USED, buf);
+        case SCREEN_VAR_DISK:
+            // Next of the fullest filesystems every disk_rotate seconds
+            return get_fullest_disk((int)(metrics_now_ns() / 1000000000LL / r->cfg->disk_rotate_s),
+                                    r->cfg->disk_top, buf, buflen);
+        case SCREEN_VAR_PROCS:
+            return eval_metric_int(METRIC_PROCS, buf);
+        case SCREEN_VAR_SWAP_USED:
+            return eval_metric_int(METRIC_SWAP_USED, buf);
+        case SCREEN_VAR_FAN_RPM:
+            return eval_metric_int(METRIC_FAN_RPM, buf);
+        case SCREEN_VAR_UPTIME:
+            m = metric_get(METRIC_UPTIME);
+            format_uptime(m->valid ? m->value : -1, buf, buflen);  // "?" if unknown
+            return 1;
+        case SCREEN_VAR_TIME: {
+            time_t now = time(NULL);
+            struct tm tm;
+            localtime_r(&now, &tm);
+            fmt_clock(buf, tm.tm_hour, tm.tm_min, tm.tm_sec);
+            return 1;
+        }
+        case SCREEN_VAR_NET:
+            m = metric_get(METRIC_NET);
+            if (!m->valid || m->stale) {
+                return 0;
+            }
+            fmt_str(buf, buflen, m->text);
+            return 1;
+        case SCREEN_VAR_HOSTNAME:
+            fmt_str(buf, buflen, metric_get(METRIC_HOSTNAME)->text);
+            return 1;
+        case SCREEN_VAR_MODEL:
+            fmt_str(buf, buflen, r->cfg->model);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int eval_var(screen_var_t var, char *buf, size_t buflen, void *ctx) {
+    lcd_render_t *r = ctx;
+    int64_t start = metrics_now_ns();
+    int ret = eval_var_sample(var, buf, buflen, ctx);
+    r->collect_ns += metrics_now_ns() - start;
+    return ret;
+}
+
+void lcd_render_compose(lcd_render_t *r, int line1_state, int line2_state,
+                        char *line1, char *line2) {
+    r->collect_ns = 0;
+
+    // Format LINE 1 from the configured screen
+    memset(line1, ' ', 40);
+    if (r->override[0]) {
+        fmt_text(line1, SCREEN_COLS, r->override[0], FMT_LEFT);
+    } else if (line1_state >= 0) {
+        screen_render(r->cfg, line1_state % r->cfg->nscreens, eval_var, r, line1);
+    }
+    line1[40] = '\0';
+
+    // Format LINE 2 based on state
+    const ip_info_t *ips = NULL;
+    int num_ips = 0;
+    int64_t start;
+    if (!r->override[1]) {
+        start = metrics_now_ns();
+        const ip_list_t *list = ips_get();
+        ips = list->ips;
+        num_ips = list->count;
+        r->collect_ns += metrics_now_ns() - start;
+    }
+
+    memset(line2, ' ', 40);
+
+    if (r->override[1]) {
+        fmt_text(line2, SCREEN_COLS, r->override[1], FMT_LEFT);
+    } else if (line2_state == 0) {
+        // State 0: Always show model name
+        fmt_text(line2, SCREEN_COLS, r->cfg->model, FMT_LEFT);
+    } else if (line2_state >= 1 && line2_state <= num_ips) {
+        // States 1 to num_ips: Show IP addresses (only when num_ips > 0).
+        // A long interface name is dropped rather than cutting the address.
+        const ip_info_t *ip = &ips[line2_state - 1];
+        int iflen = strlen(ip->ifname);
+        char ifname[sizeof(ip->ifname) + 1];
+        memcpy(ifname, ip->ifname, iflen);
+        ifname[iflen] = ':';
+        fmt_field_t f[2] = {
+            { ifname, iflen + 1, 0 },
+            { ip->ip, (int)strlen(ip->ip), 1 },
+        };
+        fmt_line(line2, SCREEN_COLS, f, 2, FMT_LEFT);
+    } else {
+        // Last state: Always show hostname
+        // When num_ips=0: daemon has 2 states (0=model, 1=hostname)
+        // When num_ips>0: daemon has 2+num_ips states (0=model, 1..num_ips=IPs, num_ips+1=hostname)
+        start = metrics_now_ns();
+        const char *hostname = metric_get(METRIC_HOSTNAME)->text;
+        r->collect_ns += metrics_now_ns() - start;
+        fmt_field_t f[2] = {
+            { "Host: ", 6, 0 },
+            { hostname, (int)strnlen(hostname, SCREEN_COLS), 1 },
+        };
+        fmt_line(line2, SCREEN_COLS, f, 2, FMT_LEFT);
+    }
+    line2[40] = '\0';
+}
+
+static int write_line(lcd_render_t *r, int fd, int line, const char *text) {
+    if (ioctl(fd, PLCM_IOCTL_SET_LINE, line + 1) < 0 || write(fd, text, 40) != 40) {
+        return -1;
+    }
+    r->bytes_sent += 40;
+    return 0;
+}
+
+// Send the dirty spans of one line. Returns 0, -1 on error, or 1 if the
+// driver doesn't know the span ioctl (nothing was written).
+static int write_spans(lcd_render_t *r, int fd, int line, const char *old, const char *text) {
+    int col = 0;
+
+    while (col < 40) {
+        if (old[col] == text[col]) {
+            col++;
+            continue;
+        }
+
+        // Extend over further changes, bridging short unchanged gaps
+        int end = col + 1;
+        for (int k = end; k < 40 && k - end < LCD_SPAN_MERGE_GAP; k++) {
+            if (old[k] != text[k]) {
+                end = k + 1;
+            }
+        }
+
+        struct plcm_span span;
+        span.line = line + 1;
+        span.col = col;
+        span.len = end - col;
+        memcpy(span.data, text + col, span.len);
+        if (ioctl(fd, PLCM_IOCTL_WRITE_SPAN, &span) < 0) {
+            if (errno == EOPNOTSUPP || errno == ENOTTY) {
+                return 1;
+            }
+            return -1;
+        }
+        r->bytes_sent += span.len;
+        col = end;
+    }
+    return 0;
+}
+
+int lcd_render_frame(lcd_render_t *r, int fd, int line1_state, int line2_state) {
+    char lines[2][41];
+
+    r->t_frame_start = metrics_now_ns();
+
+    // Display setup only needs doing once per renderer, not every frame
+    if (!r->setup_done) {
+        ioctl(fd, PLCM_IOCTL_BACKLIGHT, 1);
+        ioctl(fd, PLCM_IOCTL_DISPLAY_D, 1);
+        ioctl(fd, PLCM_IOCTL_DISPLAY_C, 0);
+        ioctl(fd, PLCM_IOCTL_DISPLAY_B, 0);
+        r->setup_done = 1;
+        r->frames_until_full = 0;  // and the panel contents are unknown
+    }
+
+    lcd_render_compose(r, line1_state, line2_state, lines[0], lines[1]);
+    r->frames_composed++;
+    r->t_composed = metrics_now_ns();
+    r->t_written = r->t_composed;
+
+    int full = r->frames == 0 || r->frames_until_full <= 0;
+    if (!full && memcmp(r->frame[0], lines[0], 40) == 0 && memcmp(r->frame[1], lines[1], 40) == 0) {
+        r->frames_skipped++;
+        return 0;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        int ret = 1;
+
+        if (!full && memcmp(r->frame[i], lines[i], 40) == 0) {
+            continue;
+        }
+        if (!full && !r->spans_unsupported) {
+            ret = write_spans(r, fd, i, r->frame[i], lines[i]);
+            if (ret > 0) {
+                r->spans_unsupported = 1;  // older driver: whole lines from now on
+            }
+        }
+        if (ret > 0) {
+            ret = write_line(r, fd, i, lines[i]);
+        }
+        if (ret < 0) {
+            r->setup_done = 0;  // redo setup (and a full frame) after e.g. a driver reload
+            return -1;
+        }
+        memcpy(r->frame[i], lines[i], 40);
+    }
+
+    r->frames_until_full = full ? LCD_FULL_REPAINT_FRAMES : r->frames_until_full - 1;
+    r->frames++;
+    r->t_written = metrics_now_ns();
+    return 0;
+}
@@ -0,0 +1,140 @@
+#ifndef LCD_RENDER_H
+#define LCD_RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "netrate.h"
+#include "screen_config.h"
+#include "hwmon.h"
+#include "mounts.h"
+
+// Renderer for the two LCD lines, shared by the one-shot lcd_vitals CLI and
+// lcd_button_daemon. The daemon keeps one lcd_render_t for its lifetime and
+// calls lcd_render_frame() in-process, instead of fork/exec'ing lcd_vitals.
+
+#define LCD_MAX_IPS      10
+
+// Unchanged runs shorter than this between two changed ones are re-sent
+// rather than paying for another DDRAM address command
+#define LCD_SPAN_MERGE_GAP     6
+// Full repaint every N written frames, in case someone else drew on the panel
+#define LCD_FULL_REPAINT_FRAMES 300
+
+typedef struct {
+    char ifname[16];
+    char ip[INET_ADDRSTRLEN];
+} ip_info_t;
+
+typedef struct {
+    const screen_config_t *cfg;  // line-1 screens, model name (never NULL)
+    int setup_done;              // display-setup ioctls issued to the driver
+    unsigned long frames;        // frames written successfully
+    char frame[2][40];           // last frame written (valid once frames > 0)
+    int frames_until_full;       // repaint everything when this reaches 0
+    int spans_unsupported;       // driver lacks PLCM_IOCTL_WRITE_SPAN
+
+    // Compositor counters
+    unsigned long frames_composed;
+    unsigned long frames_skipped;    // identical to the last frame, nothing sent
+    unsigned long bytes_sent;        // characters written to the panel
+
+    // Timing of the last lcd_render_frame() (CLOCK_MONOTONIC ns), for the
+    // daemon's latency trace. collect_ns is the part of composing spent
+    // sampling metrics.
+    int64_t t_frame_start;
+    int64_t collect_ns;
+    int64_t t_composed;
+    int64_t t_written;
+
+    // Text shown instead of each line's state (posted messages, see
+    // msgqueue.h), NULL for none
+    const char *override[2];
+} lcd_render_t;
+
+// A physical NIC as last sampled (rates from netrate.h)
+typedef struct {
+    char ifname[IFNAMSIZ];
+    netrate_sample_t last;
+    netrate_t inst;
+    netrate_t ewma;
+    netrate_t peak;
+    int have_rate;               // inst/ewma/peak are over a real interval
+    unsigned long resets;        // counter resets seen
+} lcd_net_t;
+
+void lcd_render_init(lcd_render_t *r);
+
+// Compose both lines (40 chars + NUL each, space padded) for the given states
+void lcd_render_compose(lcd_render_t *r, int line1_state, int line2_state,
+                        char *line1, char *line2);
+
+// Compose a frame and write what changed since the last one to an open
+// /dev/plcm_drv fd: nothing if identical, else the dirty spans of each line
+// (whole changed lines on drivers without PLCM_IOCTL_WRITE_SPAN).
+// Returns 0 on success, -1 if a write to the driver failed.
+int lcd_render_frame(lcd_render_t *r, int fd, int line1_state, int line2_state);
+
+// Individual collectors, sampled through the metrics registry (metrics.h)
+// by the renderer
+int collect_ip_addresses(ip_info_t *ips, int max_ips);
+// Line 2 addresses as last published by METRIC_IPS (requested when due)
+int count_ip_addresses(void);
+void get_hostname(char *buf, size_t buflen);
+int get_cpu_temp(void);           // hottest CPU sensor (hwmon.h), else first thermal zone
+int get_fan_rpm(void);            // fastest hwmon fan
+int get_disk_usage(void);         // root filesystem, from the mounts worker (mounts.h)
+// n-th (wrapping) of the top fullest filesystems as "/var 87%", stalled
+// ones first as "/mnt/nfs hung"; returns 0 if none is known yet
+int get_fullest_disk(int n, int top, char *buf, size_t buflen);
+long get_uptime_seconds(void);
+void format_uptime(long uptime_seconds, char *buf, size_t buflen);
+void get_uptime_str(char *buf, size_t buflen);
+int get_process_count(void);
+int get_load_avg(void);          // 1 minute load average, hundredths
+int get_mem_usage(void);
+int get_swap_usage(void);
+void get_network_rates(char *buf, size_t buflen);  // "RX:1.5M TX:12K"
+
+// Samplers behind METRIC_IPS and METRIC_NET, run on a collector worker.
+// lcd_render_sample_ips() publishes the addresses line 2 shows and returns
+// their number. get_network_rates() samples every physical NIC and
+// publishes them: lcd_render_net() copies the one the RX/TX view shows
+// (-1 if there is none yet), lcd_render_nets() up to max of all of them
+// and returns how many.
+int lcd_render_sample_ips(void);
+int lcd_render_net(lcd_net_t *out);
+int lcd_render_nets(lcd_net_t *out, int max);
+
+// rtnetlink socket behind the interface/address cache (opened on the first
+// call, -1 if unavailable). Readable when links or addresses changed; the
+// worker sampling METRIC_IPS applies the updates, so have it sampled with
+// metric_refresh() rather than reading the socket.
+int lcd_render_ifcache_fd(void);
+
+// Called with the sensors in use each time they were (re)discovered. Runs
+// on the collector worker that samples them, not the caller's thread.
+void lcd_render_hwmon_notify(void (*fn)(const hwmon_t *hw));
+
+// Kernel uevent socket (opened on the first call, -1 if unavailable).
+// Readable on device events; lcd_render_hwmon_update() drains it and, if a
+// hwmon device came or went, has the sensors rediscovered on their next
+// sample, returning 1 then.
+int lcd_render_hwmon_fd(void);
+int lcd_render_hwmon_update(void);
+
+// Filesystems of interest and their usage (the worker is started on the
+// first call; never waits for it). Returns -1 if the worker isn't available.
+int lcd_render_mounts(mounts_snapshot_t *snap);
+
+// mountinfo fd, POLLPRI when the mount table changed; then call
+// lcd_render_mounts_changed() to have the worker re-read it
+int lcd_render_mounts_fd(void);
+void lcd_render_mounts_changed(void);
+
+// For one-shot callers: wait up to timeout_ms for the samples a compose
+// requested and the first filesystem round. The daemon never calls this;
+// it repaints when collector_fd() (collector.h) says results are in.
+void lcd_render_settle(int timeout_ms);
+
+#endif // LCD_RENDER_H
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lcd_state.h"
+
+#define READ_RETRIES 100
+
+static int state_is_valid(const lcd_state_shm_t *shm) {
+    return shm->magic == LCD_STATE_MAGIC && shm->version == LCD_STATE_VERSION &&
+           shm->size == sizeof(lcd_state_t);
+}
+
+// /dev/shm is world-writable: only a segment created by root or by us is
+// believed
+static int owner_is_trusted(const struct stat *st) {
+    return st->st_uid == 0 || st->st_uid == geteuid();
+}
+
+// Our existing segment, or a new one. One that someone else created is
+// removed rather than adopted (with fs.protected_regular an O_CREAT open of
+// it would fail anyway). Readable by all, whatever the umask.
+static int publisher_fd(void) {
+    struct stat st;
+    int fd = shm_open(LCD_STATE_SHM_NAME, O_RDWR | O_NOFOLLOW | O_CLOEXEC, 0);
+
+    if (fd >= 0) {
+        if (fstat(fd, &st) == 0 && st.st_uid == geteuid()) {
+            return fd;
+        }
+        close(fd);
+        shm_unlink(LCD_STATE_SHM_NAME);
+    }
+    fd = shm_open(LCD_STATE_SHM_NAME, O_CREAT | O_EXCL | O_RDWR | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd >= 0 && fchmod(fd, 0644) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int lcd_state_publisher_open(lcd_state_shm_t **shm, lcd_state_t *restored) {
+    struct stat st;
+    int restored_ok = 0;
+
+    *shm = NULL;
+    int fd = publisher_fd();
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 ||
+        ((size_t)st.st_size < sizeof(lcd_state_shm_t) && ftruncate(fd, sizeof(lcd_state_shm_t)) < 0)) {
+        close(fd);
+        return -1;
+    }
+
+    lcd_state_shm_t *p = mmap(NULL, sizeof(*p), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+
+    // An odd sequence means the last publisher died mid-update
+    if (state_is_valid(p) && (p->seq & 1) == 0) {
+        memcpy(restored, &p->state, sizeof(*restored));
+        restored_ok = 1;
+    } else {
+        p->seq = 0;
+        memset(&p->state, 0, sizeof(p->state));
+        p->size = sizeof(lcd_state_t);
+        p->version = LCD_STATE_VERSION;
+        p->magic = LCD_STATE_MAGIC;
+    }
+    p->pid = getpid();
+
+    *shm = p;
+    return restored_ok;
+}
+
+void lcd_state_publish(lcd_state_shm_t *shm, const lcd_state_t *st) {
+    if (!shm) {
+        return;
+    }
+    uint32_t seq = shm->seq;
+
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&shm->state, st, sizeof(*st));
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void lcd_state_publisher_close(lcd_state_shm_t *shm) {
+    if (shm) {
+        munmap(shm, sizeof(*shm));
+    }
+}
+
+int lcd_state_read(lcd_state_t *out) {
+    struct stat st;
+    int ret = -1;
+
+    int fd = shm_open(LCD_STATE_SHM_NAME, O_RDONLY | O_NOFOLLOW | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || !owner_is_trusted(&st) || (size_t)st.st_size < sizeof(lcd_state_shm_t)) {
+        close(fd);
+        return -1;
+    }
+    const lcd_state_shm_t *shm = mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        return -1;
+    }
+
+    if (state_is_valid(shm)) {
+        for (int i = 0; i < READ_RETRIES; i++) {
+            uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+            if (seq & 1) {
+                continue;  // Writer in progress
+            }
+            memcpy(out, &shm->state, sizeof(*out));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq) {
+                ret = 0;
+                break;
+            }
+        }
+    }
+
+    munmap((void *)shm, sizeof(*shm));
+    return ret;
+}
@@ -0,0 +1,74 @@
+#ifndef LCD_STATE_H
+#define LCD_STATE_H
+
+#include <stdint.h>
+
+// Display state published by lcd_button_daemon.
+//
+// The daemon keeps line states, the last frame and the last network counter
+// sample in memory and mirrors them into a small POSIX shared memory segment
+// (/dev/shm/lcd_vitals) after every repaint. Readers (lcd_vitals, external
+// tools) map it read-only and copy it out under a seqlock, so nothing has to
+// go through files in /var/run and a reader never sees a half update.
+//
+// The segment is left in place when the daemon exits, so the next instance
+// resumes on the same screens.
+
+#define LCD_STATE_SHM_NAME  "/lcd_vitals"
+#define LCD_STATE_MAGIC     0x5644434cu   // "LCDV"
+#define LCD_STATE_VERSION   3
+
+typedef struct {
+    int32_t line1_state;
+    int32_t line1_states;
+    int32_t line2_state;
+    int32_t line2_states;
+    uint64_t frames;             // frames written by the publisher
+    uint64_t frames_composed;
+    uint64_t frames_skipped;     // identical to the previous one, not sent
+    uint64_t bytes_sent;         // characters written to the panel
+    int64_t updated;             // time() of the last publish
+    char line1[40];              // last frame sent, not NUL terminated
+    char line2[40];
+
+    // Interface on the RX/TX view and its last counter sample (see
+    // netrate.h); net_ifname is empty until the view was first shown
+    char net_ifname[16];
+    int64_t net_time_ns;         // CLOCK_MONOTONIC of the sample
+    uint64_t net_rx_bytes;
+    uint64_t net_tx_bytes;
+    uint64_t net_rx_packets;
+    uint64_t net_tx_packets;
+    uint64_t net_rx_bps;         // bits/s over the last interval
+    uint64_t net_tx_bps;
+    uint64_t net_rx_bps_ewma;
+    uint64_t net_tx_bps_ewma;
+    uint64_t net_rx_bps_peak;    // over the engine's sample ring
+    uint64_t net_tx_bps_peak;
+    uint64_t net_rx_pps;
+    uint64_t net_tx_pps;
+} lcd_state_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;               // sizeof(lcd_state_t) of the publisher
+    int32_t pid;                 // publisher, may have exited since
+    uint32_t seq;                // seqlock: odd while an update is in progress
+    uint32_t pad;
+    lcd_state_t state;
+} lcd_state_shm_t;
+
+// Create (or take over our own) segment, mode 0644. If a previous publisher
+// left a valid state behind it is copied to *restored and 1 is returned,
+// else 0. A segment owned by another user is replaced, not read.
+// Returns -1 if the segment cannot be created; *shm is then NULL.
+int lcd_state_publisher_open(lcd_state_shm_t **shm, lcd_state_t *restored);
+void lcd_state_publish(lcd_state_shm_t *shm, const lcd_state_t *st);
+void lcd_state_publisher_close(lcd_state_shm_t *shm);
+
+// Take a consistent snapshot of the published state. Returns 0, or -1 if no
+// valid segment exists or it is owned by neither root nor the caller.
+int lcd_state_read(lcd_state_t *st);
+
+#endif // LCD_STATE_H
@@ -0,0 +1,78 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ctl_socket.h"
+
+// Put a message on the LCD through lcd_button_daemon's query socket
+// (protocol in msgqueue.h). Needs to run as root or in the lcd group.
+//
+//   lcdctl -p high -k raid "RAID degraded"   alert on line 1 until cleared
+//   lcdctl -l 2 -t 300 "Backup running"       line 2 rotation, 5 minutes
+//   lcdctl -c raid                            clear it
+//   lcdctl -L                                 list the queue
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: lcdctl [-l 1|2] [-p low|normal|high] [-t ttl_s] [-k key] text...\n"
+            "       lcdctl -c key\n"
+            "       lcdctl -L\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    char req[CTL_REQUEST_MAX];
+    const char *line = "1", *prio = "normal", *ttl = "60", *key = NULL, *clear = NULL;
+    int list = 0;
+    int opt;
+    size_t len;
+
+    while ((opt = getopt(argc, argv, "l:p:t:k:c:Lh")) != -1) {
+        switch (opt) {
+            case 'l': line = optarg; break;
+            case 'p': prio = optarg; break;
+            case 't': ttl = optarg; break;
+            case 'k': key = optarg; break;
+            case 'c': clear = optarg; break;
+            case 'L': list = 1; break;
+            default: usage();
+        }
+    }
+
+    if (list) {
+        snprintf(req, sizeof(req), "messages");
+    } else if (clear) {
+        snprintf(req, sizeof(req), "clear key=%s", clear);
+    } else {
+        if (optind >= argc) {
+            usage();
+        }
+        len = snprintf(req, sizeof(req), "msg line=%s prio=%s ttl=%s", line, prio, ttl);
+        if (key && len < sizeof(req)) {
+            len += snprintf(req + len, sizeof(req) - len, " key=%s", key);
+        }
+        if (len < sizeof(req)) {
+            len += snprintf(req + len, sizeof(req) - len, " text=");
+        }
+        for (int i = optind; i < argc && len < sizeof(req); i++) {
+            len += snprintf(req + len, sizeof(req) - len, "%s%s", i > optind ? " " : "", argv[i]);
+        }
+        req[strcspn(req, "\n")] = '\0';  // one request per line
+    }
+
+    // Buffer the reply to see whether the daemon refused the request
+    char *reply = NULL;
+    size_t reply_len = 0;
+    FILE *out = open_memstream(&reply, &reply_len);
+    if (!out || ctl_query(LCD_CTL_SOCKET, req, out) != 0) {
+        perror(LCD_CTL_SOCKET);
+        return 1;
+    }
+    fclose(out);
+
+    int failed = strncmp(reply, "error", 5) == 0 || strncmp(reply, "unknown", 7) == 0;
+    fputs(reply, failed ? stderr : stdout);
+    free(reply);
+    return failed ? 1 : 0;
+}
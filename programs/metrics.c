@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "lcd_render.h"
+#include "metrics.h"
+#include "collector.h"
+
+static int sample_load1(metric_value_t *v) {
+    v->value = get_load_avg();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_mem_used(metric_value_t *v) {
+    v->value = get_mem_usage();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_cpu_temp(metric_value_t *v) {
+    v->value = get_cpu_temp();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_disk_used(metric_value_t *v) {
+    v->value = get_disk_usage();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_uptime(metric_value_t *v) {
+    v->value = get_uptime_seconds();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_procs(metric_value_t *v) {
+    v->value = get_process_count();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_swap_used(metric_value_t *v) {
+    v->value = get_swap_usage();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_fan_rpm(metric_value_t *v) {
+    v->value = get_fan_rpm();
+    return v->value >= 0 ? 0 : -1;
+}
+
+static int sample_hostname(metric_value_t *v) {
+    get_hostname(v->text, sizeof(v->text));
+    return 0;
+}
+
+static int sample_net(metric_value_t *v) {
+    get_network_rates(v->text, sizeof(v->text));
+    return 0;
+}
+
+static int sample_ips(metric_value_t *v) {
+    v->value = lcd_render_sample_ips();
+    return 0;
+}
+
+// Intervals follow how often the source can change in a way the panel shows:
+// the kernel recomputes loadavg every 5s, swap moves slowly, the hostname
+// almost never. Disk fill is statvfs'd by the mounts worker (mounts.h);
+// reading its result is cheap, so it is picked up often enough to show a
+// stalled root filesystem soon. Addresses are re-read whenever rtnetlink
+// reports a change (metric_refresh()); applying a change can mean a full
+// re-dump, so they share the slow worker with the /proc walk.
+static const metric_desc_t metric_table[METRIC_COUNT] = {
+    [METRIC_LOAD1]      = { "load1",     "/proc/loadavg",      METRIC_COST_READ,   5000,  sample_load1 },
+    [METRIC_MEM_USED]   = { "mem_used",  "/proc/meminfo",      METRIC_COST_READ,   1000,  sample_mem_used },
+    [METRIC_CPU_TEMP]   = { "cpu_temp",  "hwmon temp*_input",  METRIC_COST_READ,   2000,  sample_cpu_temp },
+    [METRIC_DISK_USED]  = { "disk_used", "mounts worker (/)",  METRIC_COST_WORKER, 5000,  sample_disk_used },
+    [METRIC_UPTIME]     = { "uptime",    "CLOCK_BOOTTIME",     METRIC_COST_CLOCK,  1000,  sample_uptime },
+    [METRIC_PROCS]      = { "procs",     "readdir(/proc)",     METRIC_COST_SCAN,   5000,  sample_procs },
+    [METRIC_SWAP_USED]  = { "swap_used", "/proc/meminfo",      METRIC_COST_READ,   10000, sample_swap_used },
+    [METRIC_FAN_RPM]    = { "fan_rpm",   "hwmon fan*_input",   METRIC_COST_READ,   2000,  sample_fan_rpm },
+    [METRIC_HOSTNAME]   = { "hostname",  "gethostname()",      METRIC_COST_READ,   60000, sample_hostname },
+    [METRIC_NET]        = { "net",       "/sys/class/net",     METRIC_COST_READ,   1000,  sample_net },
+    [METRIC_IPS]        = { "ips",       "rtnetlink cache",    METRIC_COST_SCAN,   30000, sample_ips },
+};
+
+static metric_value_t metric_values[METRIC_COUNT];  // the caller's copies
+static int metric_forced[METRIC_COUNT];
+
+int64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+const metric_value_t *metric_get(metric_id_t id) {
+    const metric_desc_t *d = &metric_table[id];
+    metric_value_t *v = &metric_values[id];
+    int64_t now = metrics_now_ns();
+    int64_t interval_ns = (int64_t)d->min_interval_ms * 1000000LL;
+    int pooled = d->cost != METRIC_COST_CLOCK && collector_start() == 0;
+
+    if (pooled) {
+        // Whatever the worker finished last; a sample in progress is not
+        // waited for
+        collector_read(id, v);
+    }
+    int due = v->sampled_ns == 0 || metric_forced[id] || now - v->sampled_ns >= interval_ns;
+    if (!due) {
+        v->stale = 0;
+        return v;
+    }
+    metric_forced[id] = 0;
+
+    if (pooled) {
+        collector_request(id);
+        v->stale = v->sampled_ns == 0 ||
+                   now - v->sampled_ns > interval_ns + METRIC_STALE_SLACK_MS * 1000000LL;
+        return v;
+    }
+    v->valid = d->sample(v) == 0;
+    v->stale = 0;
+    v->sampled_ns = now;
+    v->samples++;
+    return v;
+}
+
+void metric_refresh(metric_id_t id) {
+    metric_forced[id] = 1;
+    metric_get(id);
+}
+
+const metric_value_t *metric_peek(metric_id_t id) {
+    return &metric_values[id];
+}
+
+const metric_desc_t *metric_desc(metric_id_t id) {
+    return &metric_table[id];
+}
+
+int metric_find(const char *name) {
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (strcmp(metric_table[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void metrics_invalidate(void) {
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        metric_forced[i] = 1;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+// Registry of the metrics shown on line 1 (and the hostname and addresses
+// on line 2).
+//
+// Each metric declares its source, a cost class and a minimum refresh
+// interval. Nothing is sampled up front: metric_get() samples on demand when
+// a visible screen asks for the value and the cached one is older than the
+// interval, so a frame only pays for what it shows. Cached values carry the
+// CLOCK_MONOTONIC time they were taken, so staleness is explicit.
+//
+// Except for clock reads, sampling happens on the collector workers
+// (collector.h): metric_get() returns the latest completed sample right
+// away and, when it is due, asks for the next one. A value that is not
+// refreshed within METRIC_STALE_SLACK_MS of falling due is marked stale.
+
+typedef enum {
+    METRIC_LOAD1,                // 1 minute load average, hundredths
+    METRIC_MEM_USED,             // % of MemTotal not available
+    METRIC_CPU_TEMP,             // degrees C, hottest CPU sensor
+    METRIC_DISK_USED,            // % of / used
+    METRIC_UPTIME,               // seconds since boot
+    METRIC_PROCS,                // number of processes
+    METRIC_SWAP_USED,            // % of swap used
+    METRIC_FAN_RPM,              // fastest fan
+    METRIC_HOSTNAME,             // text
+    METRIC_NET,                  // text: RX/TX rates of the first active NIC
+    METRIC_IPS,                  // number of line 2 addresses (the list: lcd_render.h)
+    METRIC_COUNT
+} metric_id_t;
+
+// How long past its interval a value may go unrefreshed before it is stale
+#define METRIC_STALE_SLACK_MS   2000
+
+typedef enum {
+    METRIC_COST_CLOCK,           // vDSO clock read, no syscall
+    METRIC_COST_WORKER,          // copy of a worker thread's last result
+    METRIC_COST_READ,            // one syscall (pread of a persistent handle)
+    METRIC_COST_FS,              // filesystem call that may block (statvfs)
+    METRIC_COST_SCAN,            // directory walk, cost grows with the system
+} metric_cost_t;
+
+typedef struct {
+    int valid;                   // last sample succeeded
+    int stale;                   // no newer sample although one is overdue
+    long value;
+    char text[64];               // text metrics only
+    int64_t sampled_ns;          // CLOCK_MONOTONIC of the last sample, 0 = never
+    unsigned long samples;       // times the source was actually read
+} metric_value_t;
+
+typedef struct {
+    const char *name;
+    const char *source;
+    metric_cost_t cost;
+    unsigned int min_interval_ms;
+    int (*sample)(metric_value_t *v);  // fills value/text, returns 0 or -1
+} metric_desc_t;
+
+int64_t metrics_now_ns(void);
+
+// Latest value; if older than the metric's interval a new sample is
+// requested (clock metrics are re-sampled in place). Check ->valid and
+// ->stale before using ->value. Call from one thread only.
+const metric_value_t *metric_get(metric_id_t id);
+
+// Request a sample of id now, due or not (its source signalled a change)
+void metric_refresh(metric_id_t id);
+
+// Cached value as is, without sampling (may be never sampled or stale)
+const metric_value_t *metric_peek(metric_id_t id);
+
+const metric_desc_t *metric_desc(metric_id_t id);
+
+// Metric by name ("cpu_temp"), -1 if there is none
+int metric_find(const char *name);
+
+// Make the next metric_get() of every metric request a sample (e.g. on
+// SIGHUP); the values so far stay until the new ones are in
+void metrics_invalidate(void);
+
+#endif // METRICS_H
@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/statvfs.h>
+#include "metrics.h"
+#include "mounts.h"
+
+#define MS(x)           ((int64_t)(x) * 1000000LL)
+#define READ_RETRIES    100
+
+// statvfs() runs on a helper thread, which the worker waits for up to
+// MOUNTS_TIMEOUT_MS. A helper that doesn't answer in time is given up on:
+// it keeps the mount's result for whenever its statvfs returns and then
+// exits, and the next statvfs gets a new helper.
+enum {
+    HELPER_IDLE,
+    HELPER_BUSY,                 // statvfs running for the worker
+    HELPER_DONE,                 // result in, done_fd posted
+    HELPER_ABANDONED,            // the worker stopped waiting
+    HELPER_LATE,                 // ... and the statvfs has returned since
+};
+
+typedef struct {
+    int refs;                    // worker and helper thread; the last one frees it
+    int state;
+    int req_fd;                  // eventfd: a request is in path
+    int done_fd;                 // eventfd: HELPER_DONE
+    char path[64];
+    int used_pct;                // result, -1 if statvfs failed
+    int64_t done_ns;
+} helper_t;
+
+typedef struct {
+    mount_usage_t u;
+    char dev[16];                // "major:minor", one mount point per device
+    int slow;                    // last statvfs took longer than the timeout
+    helper_t *late;              // given-up helper whose statvfs this still waits for
+} mount_entry_t;
+
+static const char *const remote_types[] = {
+    "nfs", "nfs4", "cifs", "smb3", "ceph", "glusterfs", "fuse.sshfs", NULL
+};
+
+// Worker only: the mount list and its statvfs results
+static mount_entry_t table[MOUNTS_MAX];
+static int ntable;
+static uint64_t rounds;
+static int round_changed;            // a published result changed this round
+static helper_t *helper;             // takes the next statvfs, NULL until needed
+static char info_buf[65536];
+
+// Written by the worker, read by anyone through mounts_snapshot()
+static mounts_snapshot_t pub;
+static uint32_t pub_seq;             // seqlock: odd while an update is in progress
+static void (*notify_fn)(void);      // mounts_notify()
+
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+static int worker_state = -1;        // 1 once running
+static int kick_fd = -1;             // mount table changed
+static int late_fd = -1;             // a given-up helper's statvfs returned
+static int done_fd = -1;             // first round done
+static int first_done;               // ... and seen by a mounts_wait() caller
+static int info_fd = -1;
+static int info_state = 0;           // 0 not opened yet, 1 open, -1 unavailable
+
+static int is_remote(const char *fstype) {
+    for (int i = 0; remote_types[i]; i++) {
+        if (strcmp(fstype, remote_types[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Filesystems that can fill up: writable, and on a block device, ZFS or a
+// network server (not proc, tmpfs, overlay, squashfs images, ...)
+static int is_interesting(const char *opts, const char *fstype, const char *source) {
+    if (strncmp(opts, "ro", 2) == 0 && (opts[2] == ',' || opts[2] == '\0')) {
+        return 0;
+    }
+    if (is_remote(fstype) || strcmp(fstype, "zfs") == 0) {
+        return 1;
+    }
+    if (strcmp(fstype, "squashfs") == 0 || strcmp(fstype, "iso9660") == 0) {
+        return 0;
+    }
+    return source[0] == '/';
+}
+
+// mountinfo writes space, tab, newline and backslash as \ooo
+static void unescape(char *s) {
+    char *o = s;
+
+    for (; *s; s++) {
+        if (s[0] == '\\' && s[1] >= '0' && s[1] <= '3' && s[2] >= '0' && s[2] <= '7' &&
+            s[3] >= '0' && s[3] <= '7') {
+            *o++ = (char)((s[1] - '0') * 64 + (s[2] - '0') * 8 + (s[3] - '0'));
+            s += 3;
+        } else {
+            *o++ = *s;
+        }
+    }
+    *o = '\0';
+}
+
+static int find_dev(const char *dev) {
+    for (int i = 0; i < ntable; i++) {
+        if (strcmp(table[i].dev, dev) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void helper_put(helper_t *h) {
+    if (__atomic_sub_fetch(&h->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(h->req_fd);
+        close(h->done_fd);
+        free(h);
+    }
+}
+
+static int statvfs_pct(const char *path) {
+    struct statvfs st;
+
+    if (statvfs(path, &st) != 0 || st.f_blocks == 0) {
+        return -1;
+    }
+    unsigned long long used = (unsigned long long)(st.f_blocks - st.f_bavail);
+    return (int)(used * 100 / st.f_blocks);
+}
+
+static void *helper_main(void *arg) {
+    helper_t *h = arg;
+    uint64_t v;
+
+    for (;;) {
+        if (read(h->req_fd, &v, sizeof(v)) != sizeof(v)) {
+            continue;
+        }
+        h->used_pct = statvfs_pct(h->path);
+        h->done_ns = metrics_now_ns();
+        int busy = HELPER_BUSY;
+        if (__atomic_compare_exchange_n(&h->state, &busy, HELPER_DONE, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            v = 1;
+            if (write(h->done_fd, &v, sizeof(v)) < 0) {
+                // Can't happen with one request at a time
+            }
+            continue;
+        }
+        // The worker gave up on this one: leave the result, have it taken
+        // in a round now and go
+        __atomic_store_n(&h->state, HELPER_LATE, __ATOMIC_RELEASE);
+        helper_put(h);
+        v = 1;
+        if (write(late_fd, &v, sizeof(v)) < 0) {
+            // Counter full: a round is due anyway
+        }
+        return NULL;
+    }
+}
+
+// The helper to send the next statvfs to, started if there is none
+static helper_t *helper_get(void) {
+    pthread_t thread;
+
+    if (helper) {
+        return helper;
+    }
+    helper_t *h = calloc(1, sizeof(*h));
+    if (!h) {
+        return NULL;
+    }
+    h->refs = 2;
+    h->req_fd = eventfd(0, EFD_CLOEXEC);
+    h->done_fd = eventfd(0, EFD_CLOEXEC);
+    // Started from the worker, so with its signal mask (all blocked)
+    if (h->req_fd < 0 || h->done_fd < 0 || pthread_create(&thread, NULL, helper_main, h) != 0) {
+        if (h->req_fd >= 0) {
+            close(h->req_fd);
+        }
+        if (h->done_fd >= 0) {
+            close(h->done_fd);
+        }
+        free(h);
+        return NULL;
+    }
+    pthread_detach(thread);
+    helper = h;
+    return h;
+}
+
+static const mount_entry_t *find_old(const mount_entry_t *old, int nold, const char *path) {
+    for (int i = 0; i < nold; i++) {
+        if (strcmp(old[i].u.path, path) == 0) {
+            return &old[i];
+        }
+    }
+    return NULL;
+}
+
+static void add_mount(mount_entry_t *e, const char *dev, const char *path, const char *fstype) {
+    memset(e, 0, sizeof(*e));
+    snprintf(e->dev, sizeof(e->dev), "%s", dev);
+    snprintf(e->u.path, sizeof(e->u.path), "%s", path);
+    snprintf(e->u.fstype, sizeof(e->u.fstype), "%s", fstype);
+    e->u.remote = is_remote(fstype);
+    e->u.used_pct = -1;
+}
+
+// Rebuild the table from mountinfo, keeping the results of mounts that stay
+static void read_table(void) {
+    static mount_entry_t old[MOUNTS_MAX];
+    int nold = ntable;
+    size_t len = 0;
+    ssize_t n;
+
+    memcpy(old, table, sizeof(old));
+    ntable = 0;
+
+    int fd = open(MOUNTS_INFO_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        while (len < sizeof(info_buf) - 1 &&
+               (n = read(fd, info_buf + len, sizeof(info_buf) - 1 - len)) > 0) {
+            len += (size_t)n;
+        }
+        close(fd);
+    }
+    info_buf[len] = '\0';
+
+    // "36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw"
+    char *line_save;
+    for (char *line = strtok_r(info_buf, "\n", &line_save); line;
+         line = strtok_r(NULL, "\n", &line_save)) {
+        char *f[6], *fstype = NULL, *source = NULL, *save;
+        int nf = 0;
+        for (char *t = strtok_r(line, " ", &save); t; t = strtok_r(NULL, " ", &save)) {
+            if (nf < 6) {
+                f[nf++] = t;
+            } else if (strcmp(t, "-") == 0) {
+                fstype = strtok_r(NULL, " ", &save);
+                source = strtok_r(NULL, " ", &save);
+                break;
+            }
+        }
+        if (nf < 6 || !fstype || !source || !is_interesting(f[5], fstype, source)) {
+            continue;
+        }
+        unescape(f[4]);
+
+        int i = find_dev(f[2]);
+        if (i >= 0) {
+            // Bind mount or subvolume of a device already listed: keep the
+            // shortest mount point
+            if (strlen(f[4]) < strlen(table[i].u.path)) {
+                add_mount(&table[i], f[2], f[4], fstype);
+            }
+        } else if (ntable < MOUNTS_MAX) {
+            add_mount(&table[ntable++], f[2], f[4], fstype);
+        }
+    }
+
+    if (ntable == 0) {
+        add_mount(&table[ntable++], "", "/", "");  // no mountinfo: the root at least
+    }
+    for (int i = 0; i < ntable; i++) {
+        const mount_entry_t *o = find_old(old, nold, table[i].u.path);
+        if (o) {
+            table[i].u.used_pct = o->u.used_pct;
+            table[i].u.sampled_ns = o->u.sampled_ns;
+            table[i].u.stalled = o->u.stalled;
+            table[i].slow = o->slow;
+            table[i].late = o->late;
+        }
+    }
+    // A hung mount that went away (umount -l): its helper is on its own
+    for (int i = 0; i < nold; i++) {
+        if (old[i].late && !find_old(table, ntable, old[i].u.path)) {
+            helper_put(old[i].late);
+        }
+    }
+    round_changed = 1;
+}
+
+static void publish(void) {
+    uint32_t seq = pub_seq;
+
+    __atomic_store_n(&pub_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    pub.n = ntable;
+    for (int i = 0; i < ntable; i++) {
+        pub.mounts[i] = table[i].u;
+    }
+    pub.rounds = rounds;
+    __atomic_store_n(&pub_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void set_result(mount_entry_t *e, int used_pct, int64_t sampled_ns, int stalled) {
+    if (e->u.used_pct != used_pct || e->u.stalled != stalled) {
+        round_changed = 1;
+    }
+    e->u.used_pct = used_pct;
+    e->u.sampled_ns = sampled_ns;
+    e->u.stalled = stalled;
+}
+
+static void statvfs_one(int i) {
+    mount_entry_t *e = &table[i];
+    struct pollfd pfd = { .events = POLLIN };
+    uint64_t v;
+
+    if (e->late) {
+        // Still hung since a previous round, or its answer is in by now
+        if (__atomic_load_n(&e->late->state, __ATOMIC_ACQUIRE) == HELPER_LATE) {
+            set_result(e, e->late->used_pct, e->late->done_ns, 0);
+            helper_put(e->late);
+            e->late = NULL;
+            publish();
+        }
+        return;
+    }
+
+    int64_t start = metrics_now_ns();
+    helper_t *h = helper_get();
+    if (!h) {
+        // No helper thread: in place, a stalled server then holds up the worker
+        set_result(e, statvfs_pct(e->u.path), metrics_now_ns(), 0);
+        e->slow = e->u.sampled_ns - start > MS(MOUNTS_TIMEOUT_MS);
+        publish();
+        return;
+    }
+    snprintf(h->path, sizeof(h->path), "%s", e->u.path);
+    __atomic_store_n(&h->state, HELPER_BUSY, __ATOMIC_RELEASE);
+    v = 1;
+    if (write(h->req_fd, &v, sizeof(v)) < 0) {
+        // Can't happen with one request at a time
+    }
+
+    pfd.fd = h->done_fd;
+    int left_ms = MOUNTS_TIMEOUT_MS;
+    while (poll(&pfd, 1, left_ms) < 0) {
+        left_ms = MOUNTS_TIMEOUT_MS - (int)((metrics_now_ns() - start) / 1000000LL);
+        if (left_ms < 0) {
+            left_ms = 0;
+        }
+    }
+    int busy = HELPER_BUSY;
+    if (__atomic_compare_exchange_n(&h->state, &busy, HELPER_ABANDONED, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // Hung: the mount waits for this helper's answer, the next one
+        // gets a new helper
+        e->late = h;
+        e->slow = 1;
+        helper = NULL;
+        set_result(e, e->u.used_pct, e->u.sampled_ns, 1);
+        publish();
+        return;
+    }
+    // HELPER_DONE: its post is in or follows right away
+    if (read(h->done_fd, &v, sizeof(v)) < 0) {
+        // Can't happen, the helper holds the fd open
+    }
+    __atomic_store_n(&h->state, HELPER_IDLE, __ATOMIC_RELAXED);
+    set_result(e, h->used_pct, h->done_ns, 0);
+    e->slow = e->u.sampled_ns - start > MS(MOUNTS_TIMEOUT_MS);
+    publish();
+}
+
+// Local filesystems first, then network ones, then those that were slow
+// last time, so one hung server delays as little as possible
+static void run_round(void) {
+    int order[MOUNTS_MAX], n = 0;
+
+    for (int pass = 0; pass < 3; pass++) {
+        for (int i = 0; i < ntable; i++) {
+            int p = table[i].slow ? 2 : table[i].u.remote;
+            if (p == pass) {
+                order[n++] = i;
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        statvfs_one(order[i]);
+    }
+    rounds++;
+    publish();
+
+    void (*fn)(void) = __atomic_load_n(&notify_fn, __ATOMIC_ACQUIRE);
+    if (round_changed && fn) {
+        fn();
+    }
+    round_changed = 0;
+}
+
+static void *worker(void *arg) {
+    struct pollfd pfd[2] = { { .fd = kick_fd, .events = POLLIN }, { .fd = late_fd, .events = POLLIN } };
+    uint64_t v = 1;
+
+    (void)arg;
+    read_table();
+    publish();
+    run_round();
+    if (write(done_fd, &v, sizeof(v)) < 0) {
+        // mounts_wait() then times out, nothing else depends on it
+    }
+
+    for (;;) {
+        int ret = poll(pfd, 2, MOUNTS_INTERVAL_MS);
+        if (ret > 0 && (pfd[1].revents & POLLIN) && read(late_fd, &v, sizeof(v)) < 0) {
+            // Only a wakeup
+        }
+        if (ret > 0 && (pfd[0].revents & POLLIN) && read(kick_fd, &v, sizeof(v)) == sizeof(v)) {
+            read_table();
+            publish();
+        }
+        run_round();
+    }
+    return NULL;
+}
+
+static void start_worker(void) {
+    pthread_t thread;
+    sigset_t all, old;
+
+    kick_fd = eventfd(0, EFD_CLOEXEC);
+    late_fd = eventfd(0, EFD_CLOEXEC);
+    done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (kick_fd < 0 || late_fd < 0 || done_fd < 0) {
+        return;
+    }
+
+    // The worker must not take the process's signals (the daemon reads
+    // them from a signalfd); it inherits this mask
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&thread, NULL, worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        return;
+    }
+    pthread_detach(thread);
+    worker_state = 1;
+}
+
+// Called from the renderer and from the collector workers alike
+int mounts_start(void) {
+    pthread_once(&start_once, start_worker);
+    return worker_state > 0 ? 0 : -1;
+}
+
+int mounts_wait(int timeout_ms) {
+    struct pollfd pfd = { .fd = done_fd, .events = POLLIN };
+
+    if (worker_state <= 0) {
+        return -1;
+    }
+    if (__atomic_load_n(&first_done, __ATOMIC_ACQUIRE)) {
+        return 0;  // the common case, no syscall
+    }
+    // The counter is never read back, so this stays ready once it was
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return -1;
+    }
+    __atomic_store_n(&first_done, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void mounts_snapshot(mounts_snapshot_t *snap) {
+    static __thread mounts_snapshot_t last;   // last consistent copy, per reader
+    int64_t now = metrics_now_ns();
+    int i;
+
+    for (i = 0; i < READ_RETRIES; i++) {
+        uint32_t seq = __atomic_load_n(&pub_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;  // Writer in progress
+        }
+        memcpy(snap, &pub, sizeof(*snap));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&pub_seq, __ATOMIC_RELAXED) == seq) {
+            break;
+        }
+    }
+    if (i == READ_RETRIES) {
+        memcpy(snap, &last, sizeof(*snap));
+    } else {
+        memcpy(&last, snap, sizeof(last));
+    }
+
+    for (i = 0; i < snap->n; i++) {
+        mount_usage_t *m = &snap->mounts[i];
+        m->stale = m->sampled_ns != 0 && now - m->sampled_ns > MS(MOUNTS_STALE_MS);
+    }
+}
+
+void mounts_notify(void (*fn)(void)) {
+    __atomic_store_n(&notify_fn, fn, __ATOMIC_RELEASE);
+}
+
+int mounts_fd(void) {
+    if (info_state == 0) {
+        info_fd = open(MOUNTS_INFO_PATH, O_RDONLY | O_CLOEXEC);
+        info_state = info_fd >= 0 ? 1 : -1;
+    }
+    return info_fd;
+}
+
+void mounts_changed(void) {
+    uint64_t v = 1;
+
+    if (worker_state > 0 && write(kick_fd, &v, sizeof(v)) < 0) {
+        // Counter full: a re-read is pending anyway
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef MOUNTS_H
+#define MOUNTS_H
+
+#include <stdint.h>
+
+// Disk usage of the mounted filesystems of interest.
+//
+// The list comes from /proc/self/mountinfo: block-device, ZFS and network
+// filesystems mounted read-write, one mount point per device. It is only
+// re-read when the mount table changes, which the kernel signals as POLLPRI
+// on an open mountinfo file (mounts_fd(), for the caller's poll loop).
+//
+// statvfs() runs off the caller's thread: a worker hands each one to a
+// helper thread and waits for it up to MOUNTS_TIMEOUT_MS. A mount whose
+// statvfs takes longer is marked stalled and left to that helper, which the
+// worker gives up on (it exits once the call returns, and its answer is
+// taken in the next round); the worker goes on with a new helper, so a
+// stalled NFS server holds up neither the panel nor the other mounts nor
+// mount table changes. Mounts that were that slow before are done last in
+// the following rounds, after the local ones.
+//
+// Results are published under a seqlock: mounts_snapshot() copies the
+// latest without waiting and marks the ones older than MOUNTS_STALE_MS.
+
+#define MOUNTS_INFO_PATH    "/proc/self/mountinfo"
+#define MOUNTS_MAX          8
+#define MOUNTS_INTERVAL_MS  10000    // statvfs round
+#define MOUNTS_TIMEOUT_MS   2000     // a statvfs outstanding this long is stalled
+#define MOUNTS_STALE_MS     (2 * MOUNTS_INTERVAL_MS)  // used_pct missed a round
+
+typedef struct {
+    char path[64];               // mount point
+    char fstype[16];
+    int remote;                  // network filesystem
+    int used_pct;                // -1 until a statvfs succeeded
+    int64_t sampled_ns;          // CLOCK_MONOTONIC of used_pct, 0 = never
+    int stalled;                 // statvfs outstanding past MOUNTS_TIMEOUT_MS
+    int stale;                   // used_pct older than MOUNTS_STALE_MS (set by mounts_snapshot())
+} mount_usage_t;
+
+typedef struct {
+    int n;
+    mount_usage_t mounts[MOUNTS_MAX];
+    uint64_t rounds;             // statvfs rounds completed
+} mounts_snapshot_t;
+
+// Start the worker (once). Returns 0, or -1 if it could not be started.
+int mounts_start(void);
+
+// Wait up to timeout_ms for the worker's first round; 0 once it is done,
+// -1 on timeout
+int mounts_wait(int timeout_ms);
+
+// Latest published usage; never blocks
+void mounts_snapshot(mounts_snapshot_t *snap);
+
+// Called on the worker after a round in which a mount's usage or stall
+// state changed (set before mounts_start(), or from then on)
+void mounts_notify(void (*fn)(void));
+
+// mountinfo opened for POLLPRI (opened on the first call, -1 if unavailable)
+int mounts_fd(void);
+
+// The mount table changed: have the worker re-read it and start a round
+void mounts_changed(void);
+
+#endif // MOUNTS_H
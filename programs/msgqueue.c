@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ctl_socket.h"
+#include "msgqueue.h"
+#include "fmt.h"
+
+static const char *prio_names[] = {
+    [MSG_PRIO_LOW]    = "low",
+    [MSG_PRIO_NORMAL] = "normal",
+    [MSG_PRIO_HIGH]   = "high",
+};
+
+static int parse_prio(const char *s, msg_prio_t *prio) {
+    for (int p = MSG_PRIO_LOW; p <= MSG_PRIO_HIGH; p++) {
+        if (strcmp(s, prio_names[p]) == 0 || (s[0] == '0' + p && s[1] == '\0')) {
+            *prio = p;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int valid_key(const char *s) {
+    for (; *s; s++) {
+        if (!isalnum((unsigned char)*s) && !strchr("_-.:", *s)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int msg_parse(const char *req, msg_request_t *out, char *err, size_t errlen) {
+    char buf[CTL_REQUEST_MAX];
+    char *save, *tok;
+    const char *text = NULL;
+
+    memset(out, 0, sizeof(*out));
+    out->prio = MSG_PRIO_NORMAL;
+    out->ttl_s = MSG_TTL_DEFAULT;
+
+    // The text is everything after "text=", spaces included
+    snprintf(buf, sizeof(buf), "%s", req);
+    char *t = strstr(buf, " text=");
+    if (t) {
+        *t = '\0';
+        text = req + (t - buf) + 6;
+    }
+
+    tok = strtok_r(buf, " ", &save);
+    if (!tok) {
+        return 1;
+    }
+    if (strcmp(tok, "msg") == 0) {
+        out->type = MSG_REQ_POST;
+    } else if (strcmp(tok, "clear") == 0) {
+        out->type = MSG_REQ_CLEAR;
+    } else if (strcmp(tok, "messages") == 0) {
+        out->type = MSG_REQ_LIST;
+        return 0;
+    } else {
+        return 1;
+    }
+
+    while ((tok = strtok_r(NULL, " ", &save)) != NULL) {
+        char *eq = strchr(tok, '=');
+        char *end;
+        if (!eq) {
+            snprintf(err, errlen, "expected name=value, got '%s'", tok);
+            return -1;
+        }
+        *eq++ = '\0';
+        if (strcmp(tok, "key") == 0) {
+            if (strlen(eq) >= sizeof(out->key) || !valid_key(eq)) {
+                snprintf(err, errlen, "bad key (up to %d of A-Z a-z 0-9 _-.:)", MSG_KEY_MAX - 1);
+                return -1;
+            }
+            strcpy(out->key, eq);
+        } else if (strcmp(tok, "line") == 0 && (strcmp(eq, "1") == 0 || strcmp(eq, "2") == 0)) {
+            out->line = eq[0] - '1';
+        } else if (strcmp(tok, "prio") == 0 && parse_prio(eq, &out->prio) == 0) {
+            // parsed
+        } else if (strcmp(tok, "ttl") == 0) {
+            long ttl = strtol(eq, &end, 10);
+            if (*eq == '\0' || *end != '\0' || ttl < 1 || ttl > MSG_TTL_MAX) {
+                snprintf(err, errlen, "ttl must be 1-%d seconds", MSG_TTL_MAX);
+                return -1;
+            }
+            out->ttl_s = (int)ttl;
+        } else {
+            snprintf(err, errlen, "bad setting '%s=%s'", tok, eq);
+            return -1;
+        }
+    }
+
+    if (out->type == MSG_REQ_CLEAR) {
+        if (out->key[0] == '\0') {
+            snprintf(err, errlen, "clear needs key=");
+            return -1;
+        }
+        return 0;
+    }
+    if (!text || *text == '\0') {
+        snprintf(err, errlen, "msg needs text=");
+        return -1;
+    }
+    // The panel shows ASCII only; cut to the visible width
+    size_t n = 0;
+    for (; text[n] && n < MSG_TEXT_MAX; n++) {
+        out->text[n] = isprint((unsigned char)text[n]) ? text[n] : '?';
+    }
+    out->text[n] = '\0';
+    return 0;
+}
+
+int msg_post(msg_queue_t *q, const msg_request_t *req, int64_t now_ns) {
+    msg_t *slot = NULL;
+    int ret = MSG_ADDED;
+
+    q->posted++;
+    if (req->key[0] != '\0') {
+        for (int i = 0; i < MSG_MAX; i++) {
+            if (q->msgs[i].id && strcmp(q->msgs[i].key, req->key) == 0) {
+                slot = &q->msgs[i];
+                break;
+            }
+        }
+    }
+
+    if (slot) {
+        q->coalesced++;
+        slot->reposts++;
+        ret = strcmp(slot->text, req->text) == 0 && slot->line == req->line && slot->prio == req->prio
+              ? MSG_REFRESHED : MSG_REPLACED;
+    } else {
+        // Free slot, else the oldest of the lowest priority, if not above ours
+        for (int i = 0; i < MSG_MAX; i++) {
+            msg_t *m = &q->msgs[i];
+            if (!m->id) {
+                slot = m;
+                break;
+            }
+            if (!slot || m->prio < slot->prio || (m->prio == slot->prio && m->id < slot->id)) {
+                slot = m;
+            }
+        }
+        if (slot->id && slot->prio > req->prio) {
+            q->dropped++;
+            return MSG_DROPPED;
+        }
+        memset(slot, 0, sizeof(*slot));
+        slot->id = ++q->next_id;
+        snprintf(slot->key, sizeof(slot->key), "%s", req->key);
+    }
+
+    snprintf(slot->text, sizeof(slot->text), "%s", req->text);
+    slot->line = req->line;
+    slot->prio = req->prio;
+    slot->posted_ns = now_ns;
+    slot->expires_ns = now_ns + req->ttl_s * 1000000000LL;
+    return ret;
+}
+
+int msg_clear(msg_queue_t *q, const char *key) {
+    int n = 0;
+
+    for (int i = 0; i < MSG_MAX; i++) {
+        if (q->msgs[i].id && strcmp(q->msgs[i].key, key) == 0) {
+            q->msgs[i].id = 0;
+            n++;
+        }
+    }
+    return n;
+}
+
+int msg_expire(msg_queue_t *q, int64_t now_ns) {
+    int n = 0;
+
+    for (int i = 0; i < MSG_MAX; i++) {
+        if (q->msgs[i].id && now_ns >= q->msgs[i].expires_ns) {
+            q->msgs[i].id = 0;
+            n++;
+        }
+    }
+    q->expired += n;
+    return n;
+}
+
+int64_t msg_next_expiry(const msg_queue_t *q) {
+    int64_t next = 0;
+
+    for (int i = 0; i < MSG_MAX; i++) {
+        if (q->msgs[i].id && (next == 0 || q->msgs[i].expires_ns < next)) {
+            next = q->msgs[i].expires_ns;
+        }
+    }
+    return next;
+}
+
+const msg_t *msg_by_id(const msg_queue_t *q, unsigned long id) {
+    for (int i = 0; id && i < MSG_MAX; i++) {
+        if (q->msgs[i].id == id) {
+            return &q->msgs[i];
+        }
+    }
+    return NULL;
+}
+
+const msg_t *msg_alert(const msg_queue_t *q, int line) {
+    const msg_t *best = NULL;
+
+    for (int i = 0; i < MSG_MAX; i++) {
+        const msg_t *m = &q->msgs[i];
+        if (m->id && m->line == line && m->prio == MSG_PRIO_HIGH &&
+            (!best || m->posted_ns > best->posted_ns)) {
+            best = m;
+        }
+    }
+    return best;
+}
+
+const msg_t *msg_next_rotation(const msg_queue_t *q, int line, unsigned long after) {
+    const msg_t *next = NULL, *first = NULL;
+    msg_prio_t prio = MSG_PRIO_LOW;
+
+    for (int i = 0; i < MSG_MAX; i++) {
+        const msg_t *m = &q->msgs[i];
+        if (m->id && m->line == line && m->prio == MSG_PRIO_NORMAL) {
+            prio = MSG_PRIO_NORMAL;
+        }
+    }
+    for (int i = 0; i < MSG_MAX; i++) {
+        const msg_t *m = &q->msgs[i];
+        if (!m->id || m->line != line || m->prio != prio) {
+            continue;
+        }
+        if (!first || m->id < first->id) {
+            first = m;
+        }
+        if (m->id > after && (!next || m->id < next->id)) {
+            next = m;
+        }
+    }
+    return next ? next : first;
+}
+
+size_t msg_list(const msg_queue_t *q, int64_t now_ns, char *buf, size_t len) {
+    size_t pos = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    for (int i = 0; i < MSG_MAX; i++) {
+        const msg_t *m = &q->msgs[i];
+        if (!m->id) {
+            continue;
+        }
+        fmt_append(buf, len, &pos, "line=%d prio=%s ttl=%lld key=%s reposts=%lu text=%s\n", m->line + 1,
+               prio_names[m->prio], (long long)((m->expires_ns - now_ns + 999999999) / 1000000000),
+               m->key[0] ? m->key : "-", m->reposts, m->text);
+    }
+    fmt_append(buf, len, &pos, "posted %lu, coalesced %lu, dropped %lu, expired %lu\n",
+           q->posted, q->coalesced, q->dropped, q->expired);
+    return pos;
+}
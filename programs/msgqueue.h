@@ -0,0 +1,102 @@
+#ifndef MSGQUEUE_H
+#define MSGQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "screen_config.h"
+
+// Messages other programs put on the panel through lcd_button_daemon's
+// query socket (see lcdctl).
+//
+//   msg line=1 prio=high ttl=60 key=raid text=RAID degraded
+//   clear key=raid
+//   messages
+//
+// A message targets one line and lives for ttl seconds (or until cleared).
+// High priority messages take their line over at once and hold it; normal
+// ones are shown in turn as extra steps of the line's auto-cycle, low ones
+// only when no normal message waits for that line. Posting with the key of
+// a queued message replaces it instead of queueing another one, and
+// reposting the same text only extends its TTL, so a producer repeating
+// itself costs no panel writes.
+
+#define MSG_MAX             16
+#define MSG_KEY_MAX         32
+#define MSG_TEXT_MAX        SCREEN_COLS
+#define MSG_TTL_DEFAULT     60
+#define MSG_TTL_MAX         86400
+
+typedef enum {
+    MSG_PRIO_LOW,
+    MSG_PRIO_NORMAL,
+    MSG_PRIO_HIGH,
+} msg_prio_t;
+
+typedef struct {
+    unsigned long id;            // 0 = free slot
+    char key[MSG_KEY_MAX];       // "" = never coalesced
+    char text[MSG_TEXT_MAX + 1];
+    int line;                    // 0 or 1
+    msg_prio_t prio;
+    int64_t posted_ns;           // CLOCK_MONOTONIC, last (re)post
+    int64_t expires_ns;
+    unsigned long reposts;       // posts coalesced into this one
+} msg_t;
+
+typedef struct {
+    msg_t msgs[MSG_MAX];
+    unsigned long next_id;
+    unsigned long posted, coalesced, dropped, expired;
+} msg_queue_t;
+
+// Result of msg_post()
+enum {
+    MSG_DROPPED = -1,            // queue full of higher priority messages
+    MSG_ADDED,
+    MSG_REPLACED,                // same key, something visible changed
+    MSG_REFRESHED,               // same key and text, only the TTL moved
+};
+
+typedef enum {
+    MSG_REQ_POST,
+    MSG_REQ_CLEAR,
+    MSG_REQ_LIST,
+} msg_req_type_t;
+
+typedef struct {
+    msg_req_type_t type;
+    char key[MSG_KEY_MAX];
+    char text[MSG_TEXT_MAX + 1];
+    int line;
+    msg_prio_t prio;
+    int ttl_s;
+} msg_request_t;
+
+// Parse a socket request. Returns 0, or -1 with a message in err.
+// Returns 1 if the request isn't a message command at all.
+int msg_parse(const char *req, msg_request_t *out, char *err, size_t errlen);
+
+int msg_post(msg_queue_t *q, const msg_request_t *req, int64_t now_ns);
+
+// Remove the messages with this key; returns how many
+int msg_clear(msg_queue_t *q, const char *key);
+
+// Drop expired messages; returns how many
+int msg_expire(msg_queue_t *q, int64_t now_ns);
+
+// Earliest expiry, 0 if the queue is empty
+int64_t msg_next_expiry(const msg_queue_t *q);
+
+const msg_t *msg_by_id(const msg_queue_t *q, unsigned long id);
+
+// Newest high priority message for a line, NULL if none
+const msg_t *msg_alert(const msg_queue_t *q, int line);
+
+// Next normal (else low) priority message for a line after the one with
+// id `after` in posting order, wrapping around; NULL if none
+const msg_t *msg_next_rotation(const msg_queue_t *q, int line, unsigned long after);
+
+// One line per queued message, then the counters
+size_t msg_list(const msg_queue_t *q, int64_t now_ns, char *buf, size_t len);
+
+#endif // MSGQUEUE_H
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "network_interface_utils.h"
+#include "netlink_cache.h"
+
+#define NL_RCVBUF_BYTES   (1024 * 1024)  // room for bursts of veth churn
+#define NL_DUMP_TIMEOUT_MS 1000
+
+static nl_link_t *find_link(nl_cache_t *c, int ifindex) {
+    for (int i = 0; i < c->nlinks; i++) {
+        if (c->links[i].ifindex == ifindex) {
+            return &c->links[i];
+        }
+    }
+    return NULL;
+}
+
+static void remove_addrs_of(nl_cache_t *c, int ifindex) {
+    int j = 0;
+    for (int i = 0; i < c->naddrs; i++) {
+        if (c->addrs[i].ifindex != ifindex) {
+            c->addrs[j++] = c->addrs[i];
+        }
+    }
+    c->naddrs = j;
+}
+
+static int handle_link(nl_cache_t *c, const struct nlmsghdr *nh) {
+    const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    int len = nh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+    const char *name = NULL;
+
+    if (len < 0) {
+        return 0;
+    }
+
+    nl_link_t *link = find_link(c, ifi->ifi_index);
+
+    if (nh->nlmsg_type == RTM_DELLINK) {
+        if (!link) {
+            return 0;
+        }
+        remove_addrs_of(c, ifi->ifi_index);
+        *link = c->links[--c->nlinks];
+        return 1;
+    }
+
+    for (const struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            name = RTA_DATA(rta);
+        }
+    }
+    if (!name) {
+        return 0;
+    }
+
+    if (!link) {
+        if (c->nlinks == c->links_cap) {
+            int cap = c->links_cap ? c->links_cap * 2 : 16;
+            nl_link_t *links = realloc(c->links, cap * sizeof(*links));
+            if (!links) {
+                return 0;
+            }
+            c->links = links;
+            c->links_cap = cap;
+        }
+        link = &c->links[c->nlinks++];
+        memset(link, 0, sizeof(*link));
+        link->ifindex = ifi->ifi_index;
+    } else if (link->flags == ifi->ifi_flags && strcmp(link->ifname, name) == 0) {
+        return 0;  // Stats-only update, nothing we show changed
+    }
+
+    // Classify once per ifindex, and again only if the link was renamed
+    if (link->ifname[0] == '\0' || strcmp(link->ifname, name) != 0) {
+        strncpy(link->ifname, name, sizeof(link->ifname) - 1);
+        link->ifname[sizeof(link->ifname) - 1] = '\0';
+        link->is_virtual = is_virtual_interface(link->ifname);
+    }
+    link->flags = ifi->ifi_flags;
+    return 1;
+}
+
+static int handle_addr(nl_cache_t *c, const struct nlmsghdr *nh) {
+    const struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+    int len = nh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifa));
+    const struct in_addr *local = NULL, *address = NULL;
+    const char *label = NULL;
+
+    if (len < 0 || ifa->ifa_family != AF_INET) {
+        return 0;
+    }
+
+    for (const struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFA_LOCAL) {
+            local = RTA_DATA(rta);
+        } else if (rta->rta_type == IFA_ADDRESS) {
+            address = RTA_DATA(rta);
+        } else if (rta->rta_type == IFA_LABEL) {
+            label = RTA_DATA(rta);
+        }
+    }
+    // IFA_LOCAL is the interface's own address (differs on point-to-point)
+    if (local) {
+        address = local;
+    }
+    if (!address) {
+        return 0;
+    }
+
+    int pos = c->naddrs;
+    for (int i = 0; i < c->naddrs; i++) {
+        if (c->addrs[i].ifindex == (int)ifa->ifa_index &&
+            c->addrs[i].addr.s_addr == address->s_addr) {
+            pos = i;
+            break;
+        }
+    }
+
+    if (nh->nlmsg_type == RTM_DELADDR) {
+        if (pos == c->naddrs) {
+            return 0;
+        }
+        memmove(&c->addrs[pos], &c->addrs[pos + 1], (c->naddrs - pos - 1) * sizeof(*c->addrs));
+        c->naddrs--;
+        return 1;
+    }
+    if (pos != c->naddrs) {
+        return 0;  // Already known (lifetime refresh)
+    }
+
+    if (c->naddrs == c->addrs_cap) {
+        int cap = c->addrs_cap ? c->addrs_cap * 2 : 16;
+        nl_addr_t *addrs = realloc(c->addrs, cap * sizeof(*addrs));
+        if (!addrs) {
+            return 0;
+        }
+        c->addrs = addrs;
+        c->addrs_cap = cap;
+    }
+
+    // Keep ifindex order, new addresses after existing ones on the same link
+    pos = c->naddrs;
+    while (pos > 0 && c->addrs[pos - 1].ifindex > (int)ifa->ifa_index) {
+        pos--;
+    }
+    memmove(&c->addrs[pos + 1], &c->addrs[pos], (c->naddrs - pos) * sizeof(*c->addrs));
+    c->naddrs++;
+
+    nl_addr_t *a = &c->addrs[pos];
+    memset(a, 0, sizeof(*a));
+    a->ifindex = ifa->ifa_index;
+    a->addr = *address;
+    if (label) {
+        strncpy(a->label, label, sizeof(a->label) - 1);
+    }
+    return 1;
+}
+
+// Apply the messages in one datagram. Returns changes, or -1 with *done set
+// to 1 when a dump finished and 2 when it was interrupted.
+static int handle_buffer(nl_cache_t *c, const char *buf, ssize_t n, int *done) {
+    int changes = 0;
+
+    for (const struct nlmsghdr *nh = (const struct nlmsghdr *)buf; NLMSG_OK(nh, n); nh = NLMSG_NEXT(nh, n)) {
+        if (nh->nlmsg_flags & NLM_F_DUMP_INTR) {
+            *done = 2;
+        }
+        switch (nh->nlmsg_type) {
+            case NLMSG_DONE:
+                if (*done == 0) {
+                    *done = 1;
+                }
+                break;
+            case NLMSG_ERROR:
+                *done = 2;
+                break;
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                changes += handle_link(c, nh);
+                break;
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                changes += handle_addr(c, nh);
+                break;
+        }
+    }
+    return changes;
+}
+
+static int dump(nl_cache_t *c, int type) {
+    struct {
+        struct nlmsghdr nh;
+        struct rtgenmsg g;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.g));
+    req.nh.nlmsg_type = type;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++c->seq;
+    req.g.rtgen_family = type == RTM_GETADDR ? AF_INET : AF_UNSPEC;
+
+    if (send(c->fd, &req, req.nh.nlmsg_len, 0) < 0) {
+        return -1;
+    }
+
+    // Notifications may arrive interleaved with the dump; they are applied
+    // the same way, so order doesn't matter
+    for (;;) {
+        char buf[16384] __attribute__((aligned(NLMSG_ALIGNTO)));
+        int done = 0;
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+                if (poll(&pfd, 1, NL_DUMP_TIMEOUT_MS) <= 0) {
+                    return -1;
+                }
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        handle_buffer(c, buf, n, &done);
+        if (done == 1) {
+            return 0;
+        }
+        if (done == 2) {
+            return -1;
+        }
+    }
+}
+
+// Drop everything and reload from a fresh dump
+static int resync(nl_cache_t *c) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        c->nlinks = 0;
+        c->naddrs = 0;
+        if (dump(c, RTM_GETLINK) == 0 && dump(c, RTM_GETADDR) == 0) {
+            c->generation++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int nl_cache_open(nl_cache_t *c) {
+    struct sockaddr_nl sa;
+    int groups[] = { RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR };
+    int rcvbuf = NL_RCVBUF_BYTES;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (c->fd < 0) {
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (bind(c->fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        nl_cache_close(c);
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); i++) {
+        if (setsockopt(c->fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &groups[i], sizeof(groups[i])) < 0) {
+            nl_cache_close(c);
+            return -1;
+        }
+    }
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (resync(c) != 0) {
+        nl_cache_close(c);
+        return -1;
+    }
+    return 0;
+}
+
+void nl_cache_close(nl_cache_t *c) {
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    free(c->links);
+    free(c->addrs);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+int nl_cache_process(nl_cache_t *c) {
+    int changes = 0;
+
+    if (c->fd < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        char buf[16384] __attribute__((aligned(NLMSG_ALIGNTO)));
+        int done = 0;
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // We missed notifications; the only safe answer is a re-dump
+                if (resync(c) != 0) {
+                    return -1;
+                }
+                changes++;
+                continue;
+            }
+            return -1;
+        }
+        changes += handle_buffer(c, buf, n, &done);
+    }
+
+    if (changes > 0) {
+        c->generation++;
+    }
+    return changes;
+}
+
+static int is_shown(const nl_link_t *link) {
+    return link && (link->flags & IFF_UP) && !(link->flags & IFF_LOOPBACK) && !link->is_virtual;
+}
+
+int nl_cache_for_each_shown(nl_cache_t *c, nl_addr_cb cb, void *arg) {
+    int count = 0;
+
+    for (int i = 0; i < c->naddrs; i++) {
+        const nl_link_t *link = find_link(c, c->addrs[i].ifindex);
+        if (!is_shown(link)) {
+            continue;
+        }
+        count++;
+        if (cb && cb(link, &c->addrs[i], arg) != 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+int nl_cache_count_shown(nl_cache_t *c) {
+    return nl_cache_for_each_shown(c, NULL, NULL);
+}
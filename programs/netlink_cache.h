@@ -0,0 +1,55 @@
+#ifndef NETLINK_CACHE_H
+#define NETLINK_CACHE_H
+
+#include <net/if.h>
+#include <netinet/in.h>
+
+// In-process cache of network interfaces and their IPv4 addresses, keyed by
+// ifindex.
+//
+// Seeded with one RTM_GETLINK and one RTM_GETADDR dump, then kept current from
+// the RTNLGRP_LINK / RTNLGRP_IPV4_IFADDR multicast groups. Virtual/physical
+// classification (is_virtual_interface) runs once per ifindex, when the link
+// is first seen or renamed, instead of a readlink() per address per frame.
+
+typedef struct {
+    int ifindex;
+    unsigned int flags;          // IFF_* from the last RTM_NEWLINK
+    int is_virtual;
+    char ifname[IFNAMSIZ];
+} nl_link_t;
+
+typedef struct {
+    int ifindex;
+    struct in_addr addr;
+    char label[IFNAMSIZ];        // IFA_LABEL (e.g. "eth0:1"), else link name
+} nl_addr_t;
+
+typedef struct {
+    int fd;                      // NETLINK_ROUTE socket, non-blocking
+    unsigned int seq;
+    unsigned int generation;     // bumped whenever links or addresses change
+    nl_link_t *links;
+    int nlinks, links_cap;
+    nl_addr_t *addrs;            // kept sorted by ifindex
+    int naddrs, addrs_cap;
+} nl_cache_t;
+
+// Open the socket, subscribe and load the initial dump. Returns 0 or -1.
+int nl_cache_open(nl_cache_t *c);
+void nl_cache_close(nl_cache_t *c);
+
+// fd to poll for pending updates (POLLIN)
+static inline int nl_cache_fd(const nl_cache_t *c) { return c->fd; }
+
+// Apply all pending notifications without blocking. Re-dumps if the socket
+// overflowed. Returns the number of messages that changed the cache, or -1.
+int nl_cache_process(nl_cache_t *c);
+
+// Shown addresses: IPv4 on links that are up, not loopback and not virtual,
+// in ifindex order (same filter the getifaddrs() scan used)
+typedef int (*nl_addr_cb)(const nl_link_t *link, const nl_addr_t *addr, void *arg);
+int nl_cache_for_each_shown(nl_cache_t *c, nl_addr_cb cb, void *arg);
+int nl_cache_count_shown(nl_cache_t *c);
+
+#endif // NETLINK_CACHE_H
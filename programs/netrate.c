@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "netrate.h"
+
+// Plausibility bounds for one counter delta: well above any NIC this box
+// can carry (400Gbit/s, 1 packet per ns)
+#define NETRATE_MAX_BYTES_PER_NS   50
+#define NETRATE_MAX_PACKETS_PER_NS 1
+
+static const char *counter_names[4] = { "rx_bytes", "tx_bytes", "rx_packets", "tx_packets" };
+
+static netrate_if_t netrate_ifs[NETRATE_MAX_IFS];
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+netrate_if_t *netrate_if(const char *ifname) {
+    netrate_if_t *victim = NULL;
+
+    for (int i = 0; i < NETRATE_MAX_IFS; i++) {
+        netrate_if_t *nif = &netrate_ifs[i];
+        if (nif->ifname[0] == '\0') {
+            if (!victim || victim->ifname[0] != '\0') {
+                victim = nif;  // Free slot beats any in-use one
+            }
+            continue;
+        }
+        if (strcmp(nif->ifname, ifname) == 0) {
+            nif->last_used_ns = now_ns();
+            return nif;
+        }
+        if (!victim || (victim->ifname[0] != '\0' && nif->last_used_ns < victim->last_used_ns)) {
+            victim = nif;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        sample_close(&victim->src[i]);
+    }
+    memset(victim, 0, sizeof(*victim));
+    strncpy(victim->ifname, ifname, sizeof(victim->ifname) - 1);
+    for (int i = 0; i < 4; i++) {
+        victim->src[i].fd = -1;
+        if (sample_set_path(&victim->src[i], "/sys/class/net/%s/statistics/%s",
+                            victim->ifname, counter_names[i]) != 0) {
+            victim->src[i].path[0] = '\0';
+        }
+    }
+    victim->last_used_ns = now_ns();
+    return victim;
+}
+
+// Counter delta, allowing for wrap. A wrap is only believed if the counter
+// was in the top half of its range; anything else going backwards, or a
+// delta larger than the link could carry, is a reset. Returns 0 or -1.
+static int counter_delta(uint64_t prev, uint64_t cur, uint64_t max_delta, uint64_t *delta) {
+    if (cur >= prev) {
+        *delta = cur - prev;
+    } else if (prev <= UINT32_MAX && prev > UINT32_MAX / 2) {
+        *delta = cur + (1ULL << 32) - prev;  // 32-bit counter wrapped
+    } else if (prev > UINT64_MAX / 2) {
+        *delta = cur - prev;  // 64-bit wrap, modulo arithmetic does it
+    } else {
+        return -1;
+    }
+    return *delta <= max_delta ? 0 : -1;
+}
+
+static double per_second(uint64_t delta, int64_t dt_ns) {
+    return (double)delta * 1e9 / (double)dt_ns;
+}
+
+static void ewma_update(double *avg, double sample, double alpha) {
+    *avg += alpha * (sample - *avg);
+}
+
+void netrate_push(netrate_if_t *nif, const netrate_sample_t *s) {
+    netrate_sample_t cur = *s;
+    const netrate_sample_t *prev = netrate_last(nif);
+
+    memset(&cur.rate, 0, sizeof(cur.rate));
+
+    if (prev) {
+        int64_t dt = cur.t_ns - prev->t_ns;
+        if (dt < (int64_t)NETRATE_MIN_DT_MS * 1000000LL) {
+            return;  // Too close to the last one to say anything (or older)
+        }
+
+        uint64_t max_bytes = (uint64_t)dt * NETRATE_MAX_BYTES_PER_NS;
+        uint64_t max_packets = (uint64_t)dt * NETRATE_MAX_PACKETS_PER_NS;
+        uint64_t d_rx, d_tx, d_rxp, d_txp;
+
+        if (counter_delta(prev->rx_bytes, cur.rx_bytes, max_bytes, &d_rx) != 0 ||
+            counter_delta(prev->tx_bytes, cur.tx_bytes, max_bytes, &d_tx) != 0 ||
+            counter_delta(prev->rx_packets, cur.rx_packets, max_packets, &d_rxp) != 0 ||
+            counter_delta(prev->tx_packets, cur.tx_packets, max_packets, &d_txp) != 0) {
+            // Reset: this sample becomes the new baseline; the averages
+            // carry on from the next interval
+            nif->resets++;
+            nif->count = 0;
+            prev = NULL;
+        } else {
+            cur.rate.rx_bits = per_second(d_rx, dt) * 8;
+            cur.rate.tx_bits = per_second(d_tx, dt) * 8;
+            cur.rate.rx_packets = per_second(d_rxp, dt);
+            cur.rate.tx_packets = per_second(d_txp, dt);
+
+            if (!nif->have_rate) {
+                nif->ewma = cur.rate;
+            } else {
+                // Time-weighted so irregular sample spacing doesn't skew it
+                double alpha = (double)dt / ((double)dt + NETRATE_EWMA_TAU_MS * 1e6);
+                ewma_update(&nif->ewma.rx_bits, cur.rate.rx_bits, alpha);
+                ewma_update(&nif->ewma.tx_bits, cur.rate.tx_bits, alpha);
+                ewma_update(&nif->ewma.rx_packets, cur.rate.rx_packets, alpha);
+                ewma_update(&nif->ewma.tx_packets, cur.rate.tx_packets, alpha);
+            }
+            nif->inst = cur.rate;
+            nif->have_rate = 1;
+        }
+    }
+
+    nif->head = nif->count ? (nif->head + 1) % NETRATE_RING : 0;
+    nif->ring[nif->head] = cur;
+    if (nif->count < NETRATE_RING) {
+        nif->count++;
+    }
+
+    // Peak over what is still in the ring (the baseline sample has no rate)
+    memset(&nif->peak, 0, sizeof(nif->peak));
+    for (unsigned int i = 0; i < nif->count; i++) {
+        const netrate_t *r = &nif->ring[i].rate;
+        if (r->rx_bits > nif->peak.rx_bits) nif->peak.rx_bits = r->rx_bits;
+        if (r->tx_bits > nif->peak.tx_bits) nif->peak.tx_bits = r->tx_bits;
+        if (r->rx_packets > nif->peak.rx_packets) nif->peak.rx_packets = r->rx_packets;
+        if (r->tx_packets > nif->peak.tx_packets) nif->peak.tx_packets = r->tx_packets;
+    }
+}
+
+int netrate_sample(netrate_if_t *nif) {
+    netrate_sample_t s;
+    unsigned long v[4];
+
+    for (int i = 0; i < 4; i++) {
+        if (sample_read_ulong(&nif->src[i], &v[i]) != 0) {
+            return -1;
+        }
+    }
+    memset(&s, 0, sizeof(s));
+    s.t_ns = now_ns();
+    s.rx_bytes = v[0];
+    s.tx_bytes = v[1];
+    s.rx_packets = v[2];
+    s.tx_packets = v[3];
+    netrate_push(nif, &s);
+    return 0;
+}
+
+const netrate_sample_t *netrate_last(const netrate_if_t *nif) {
+    return nif->count ? &nif->ring[nif->head] : NULL;
+}
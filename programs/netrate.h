@@ -0,0 +1,71 @@
+#ifndef NETRATE_H
+#define NETRATE_H
+
+#include <stdint.h>
+#include <net/if.h>
+#include "sampler.h"
+
+// Per-interface network rate engine.
+//
+// Byte and packet counters are read from /sys/class/net/<if>/statistics via
+// persistent handles and stamped with CLOCK_MONOTONIC nanoseconds, so rates
+// are exact over whatever interval elapsed instead of whole time() seconds.
+// Each interface keeps a ring of recent samples. Counter deltas survive both
+// 64-bit wrap and 32-bit wrap (drivers that still export 32-bit counters);
+// a delta no link could have carried in the elapsed time is treated as a
+// counter reset and starts a new baseline instead.
+
+#define NETRATE_RING        16   // samples kept per interface
+#define NETRATE_MAX_IFS     8
+#define NETRATE_EWMA_TAU_MS 5000 // EWMA time constant
+#define NETRATE_MIN_DT_MS   10   // closer samples are ignored (noise)
+
+typedef struct {
+    double rx_bits;              // per second
+    double tx_bits;
+    double rx_packets;
+    double tx_packets;
+} netrate_t;
+
+typedef struct {
+    int64_t t_ns;                // CLOCK_MONOTONIC
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint64_t rx_packets;
+    uint64_t tx_packets;
+    netrate_t rate;              // since the previous sample, 0 for a baseline
+} netrate_sample_t;
+
+typedef struct {
+    char ifname[IFNAMSIZ];
+    sample_src_t src[4];         // rx_bytes, tx_bytes, rx_packets, tx_packets
+    netrate_sample_t ring[NETRATE_RING];
+    unsigned int head;           // slot of the newest sample
+    unsigned int count;          // samples in the ring
+    int have_rate;               // inst/ewma/peak valid
+    netrate_t inst;              // over the last sample interval
+    netrate_t ewma;              // time-weighted, NETRATE_EWMA_TAU_MS
+    netrate_t peak;              // highest inst still in the ring
+    unsigned long resets;        // counter resets seen (NIC reset, driver reload)
+    int64_t last_used_ns;
+} netrate_if_t;
+
+// The interface table is not locked: in the daemon only the collector
+// worker sampling METRIC_NET uses it (lcd_render.h publishes its results)
+
+// Engine slot for an interface, created (or recycled from the least
+// recently used one) on first use
+netrate_if_t *netrate_if(const char *ifname);
+
+// Read the counters now and update the rates. Returns 0, or -1 if the
+// counters could not be read.
+int netrate_sample(netrate_if_t *nif);
+
+// Add a sample taken elsewhere (e.g. the daemon's last one, published in
+// lcd_state), applying the same wrap/reset rules
+void netrate_push(netrate_if_t *nif, const netrate_sample_t *s);
+
+// Newest sample, NULL if none yet
+const netrate_sample_t *netrate_last(const netrate_if_t *nif);
+
+#endif // NETRATE_H
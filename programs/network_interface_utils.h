@@ -1,6 +1,7 @@
 #ifndef NETWORK_INTERFACE_UTILS_H
 #define NETWORK_INTERFACE_UTILS_H
 
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
@@ -112,7 +113,7 @@ static int is_logical_interface(const char *ifname) {
 // - Bonds, bridges, teams, macvlan, ipvlan are treated as "physical" (return 0)
 //   even though they're under /sys/devices/virtual/, because they commonly carry
 //   management IPs on appliances
-int is_virtual_interface(const char *ifname) {
+static inline int is_virtual_interface(const char *ifname) {
     char path[256];
     char target[4096];
     ssize_t len;
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "prom_export.h"
+#include "metrics.h"
+#include "netrate.h"
+#include "fmt.h"
+
+// First exported histogram bucket: log2 bucket 9 ends at 1.024us
+#define HIST_FIRST_BUCKET 9
+
+typedef struct {
+    metric_id_t id;
+    const char *name;
+    const char *help;
+    double scale;                // value / scale
+} gauge_t;
+
+static const gauge_t gauges[] = {
+    { METRIC_LOAD1,     "lcd_load1",                   "1 minute load average", 100 },
+    { METRIC_MEM_USED,  "lcd_memory_used_percent",     "Memory not available, percent of total", 1 },
+    { METRIC_CPU_TEMP,  "lcd_cpu_temperature_celsius", "Hottest CPU sensor", 1 },
+    { METRIC_DISK_USED, "lcd_disk_used_percent",       "Root filesystem used, percent", 1 },
+    { METRIC_UPTIME,    "lcd_uptime_seconds",          "Time since boot", 1 },
+    { METRIC_PROCS,     "lcd_processes",               "Number of processes", 1 },
+    { METRIC_SWAP_USED, "lcd_swap_used_percent",       "Swap used, percent of total", 1 },
+    { METRIC_FAN_RPM,   "lcd_fan_speed_rpm",           "Fastest fan", 1 },
+};
+
+// Label value with '"' and '\' escaped (the model text comes from the config)
+static const char *label(const char *s, char *out, size_t len) {
+    size_t o = 0;
+
+    for (; *s && o + 2 < len; s++) {
+        if (*s == '"' || *s == '\\') {
+            out[o++] = '\\';
+        }
+        out[o++] = *s;
+    }
+    out[o] = '\0';
+    return out;
+}
+
+static void header(char *buf, size_t len, size_t *pos, const char *name, const char *type,
+                   const char *help) {
+    fmt_append(buf, len, pos, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// A log2 histogram as a Prometheus histogram in seconds
+static void histogram(char *buf, size_t len, size_t *pos, const char *name, const lat_hist_t *h) {
+    uint64_t cum = 0;
+
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        cum += h->buckets[b];
+        if (b >= HIST_FIRST_BUCKET && b < LAT_BUCKETS - 1) {
+            fmt_append(buf, len, pos, "%s_bucket{le=\"%.9g\"} %llu\n", name,
+                   (double)(2ULL << b) / 1e9, (unsigned long long)cum);
+        }
+    }
+    fmt_append(buf, len, pos, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)h->count);
+    fmt_append(buf, len, pos, "%s_sum %.9f\n", name, h->sum_ns / 1e9);
+    fmt_append(buf, len, pos, "%s_count %llu\n", name, (unsigned long long)h->count);
+}
+
+// Filesystems of interest, from the mounts worker's last round
+static void format_mounts(char *buf, size_t len, size_t *pos) {
+    mounts_snapshot_t snap;
+    char path[2 * sizeof(snap.mounts[0].path)];
+
+    if (lcd_render_mounts(&snap) != 0 || snap.n == 0) {
+        return;
+    }
+    header(buf, len, pos, "lcd_filesystem_used_percent", "gauge",
+           "Filesystem used, percent (mounts of interest)");
+    for (int i = 0; i < snap.n; i++) {
+        const mount_usage_t *m = &snap.mounts[i];
+        if (m->used_pct >= 0 && !m->stale) {
+            fmt_append(buf, len, pos, "lcd_filesystem_used_percent{mountpoint=\"%s\",fstype=\"%s\"} %d\n",
+                   label(m->path, path, sizeof(path)), m->fstype, m->used_pct);
+        }
+    }
+    header(buf, len, pos, "lcd_filesystem_stalled", "gauge",
+           "statvfs outstanding for longer than the timeout (1) or not (0)");
+    for (int i = 0; i < snap.n; i++) {
+        fmt_append(buf, len, pos, "lcd_filesystem_stalled{mountpoint=\"%s\"} %d\n",
+               label(snap.mounts[i].path, path, sizeof(path)), snap.mounts[i].stalled);
+    }
+}
+
+static void format_vitals(char *buf, size_t len, size_t *pos, const lcd_render_t *r) {
+    int64_t now = metrics_now_ns();
+    char host[2 * sizeof(metric_peek(METRIC_HOSTNAME)->text)], model[2 * sizeof(r->cfg->model)];
+
+    for (size_t i = 0; i < sizeof(gauges) / sizeof(gauges[0]); i++) {
+        const metric_value_t *m = metric_get(gauges[i].id);
+        if (!m->valid) {
+            continue;  // absent rather than a made-up value
+        }
+        header(buf, len, pos, gauges[i].name, "gauge", gauges[i].help);
+        fmt_append(buf, len, pos, "%s %.9g\n", gauges[i].name, m->value / gauges[i].scale);
+    }
+
+    format_mounts(buf, len, pos);
+
+    header(buf, len, pos, "lcd_info", "gauge", "Hostname and model shown on the panel");
+    fmt_append(buf, len, pos, "lcd_info{hostname=\"%s\",model=\"%s\"} 1\n",
+           label(metric_get(METRIC_HOSTNAME)->text, host, sizeof(host)),
+           label(r->cfg->model, model, sizeof(model)));
+
+    header(buf, len, pos, "lcd_metric_age_seconds", "gauge", "Age of the cached sample");
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        const metric_value_t *m = metric_peek(id);
+        if (m->sampled_ns != 0) {
+            fmt_append(buf, len, pos, "lcd_metric_age_seconds{metric=\"%s\"} %.3f\n",
+                   metric_desc(id)->name, (now - m->sampled_ns) / 1e9);
+        }
+    }
+    header(buf, len, pos, "lcd_metric_stale", "gauge",
+           "Sample overdue past its interval and slack (1), shown as unavailable");
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        fmt_append(buf, len, pos, "lcd_metric_stale{metric=\"%s\"} %d\n",
+               metric_desc(id)->name, metric_peek(id)->stale);
+    }
+    header(buf, len, pos, "lcd_metric_samples_total", "counter", "Times the source was read");
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        fmt_append(buf, len, pos, "lcd_metric_samples_total{metric=\"%s\"} %lu\n",
+               metric_desc(id)->name, metric_peek(id)->samples);
+    }
+}
+
+// Physical NICs as the worker sampling METRIC_NET last published them
+// (asking it for a fresh round for the next export); nothing is read here
+static void format_net(char *buf, size_t len, size_t *pos) {
+    lcd_net_t ifs[NETRATE_MAX_IFS];
+
+    metric_get(METRIC_NET);
+    int n = lcd_render_nets(ifs, NETRATE_MAX_IFS);
+    if (n == 0) {
+        return;
+    }
+
+    static const struct {
+        const char *name;
+        const char *help;
+        size_t off;
+    } counters[] = {
+        { "lcd_net_receive_bytes_total",    "Bytes received",      offsetof(netrate_sample_t, rx_bytes) },
+        { "lcd_net_transmit_bytes_total",   "Bytes sent",          offsetof(netrate_sample_t, tx_bytes) },
+        { "lcd_net_receive_packets_total",  "Packets received",    offsetof(netrate_sample_t, rx_packets) },
+        { "lcd_net_transmit_packets_total", "Packets sent",        offsetof(netrate_sample_t, tx_packets) },
+    };
+    for (size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+        header(buf, len, pos, counters[c].name, "counter", counters[c].help);
+        for (int i = 0; i < n; i++) {
+            const netrate_sample_t *s = &ifs[i].last;
+            fmt_append(buf, len, pos, "%s{interface=\"%s\"} %llu\n", counters[c].name, ifs[i].ifname,
+                   (unsigned long long)*(const uint64_t *)((const char *)s + counters[c].off));
+        }
+    }
+
+    header(buf, len, pos, "lcd_net_receive_bits_per_second", "gauge",
+           "Receive rate, 5s EWMA");
+    for (int i = 0; i < n; i++) {
+        if (ifs[i].have_rate) {
+            fmt_append(buf, len, pos, "lcd_net_receive_bits_per_second{interface=\"%s\"} %.0f\n",
+                   ifs[i].ifname, ifs[i].ewma.rx_bits);
+        }
+    }
+    header(buf, len, pos, "lcd_net_transmit_bits_per_second", "gauge",
+           "Transmit rate, 5s EWMA");
+    for (int i = 0; i < n; i++) {
+        if (ifs[i].have_rate) {
+            fmt_append(buf, len, pos, "lcd_net_transmit_bits_per_second{interface=\"%s\"} %.0f\n",
+                   ifs[i].ifname, ifs[i].ewma.tx_bits);
+        }
+    }
+    header(buf, len, pos, "lcd_net_counter_resets_total", "counter",
+           "Counter resets seen (NIC reset, driver reload)");
+    for (int i = 0; i < n; i++) {
+        fmt_append(buf, len, pos, "lcd_net_counter_resets_total{interface=\"%s\"} %lu\n",
+               ifs[i].ifname, ifs[i].resets);
+    }
+}
+
+static void format_daemon(char *buf, size_t len, size_t *pos, const lcd_render_t *r,
+                          const prom_daemon_stats_t *st, const lat_trace_t *trace) {
+    header(buf, len, pos, "lcd_frames_written_total", "counter", "Frames written to the panel");
+    fmt_append(buf, len, pos, "lcd_frames_written_total %lu\n", r->frames);
+    header(buf, len, pos, "lcd_frames_composed_total", "counter", "Frames composed");
+    fmt_append(buf, len, pos, "lcd_frames_composed_total %lu\n", r->frames_composed);
+    header(buf, len, pos, "lcd_frames_skipped_total", "counter",
+           "Frames identical to the last one, nothing sent");
+    fmt_append(buf, len, pos, "lcd_frames_skipped_total %lu\n", r->frames_skipped);
+    header(buf, len, pos, "lcd_panel_bytes_sent_total", "counter", "Characters written to the panel");
+    fmt_append(buf, len, pos, "lcd_panel_bytes_sent_total %lu\n", r->bytes_sent);
+
+    header(buf, len, pos, "lcd_render_duration_seconds", "histogram",
+           "Compose and write of one frame");
+    histogram(buf, len, pos, "lcd_render_duration_seconds", &st->render);
+
+    header(buf, len, pos, "lcd_keypad_events_total", "counter", "Keypad gestures by type");
+    for (int t = 0; t < KEYPAD_EV_COUNT; t++) {
+        fmt_append(buf, len, pos, "lcd_keypad_events_total{type=\"%s\"} %llu\n", keypad_ev_name(t),
+               (unsigned long long)st->keypad_events[t]);
+    }
+
+    header(buf, len, pos, "lcd_driver_errors_total", "counter", "Failed /dev/plcm_drv calls");
+    fmt_append(buf, len, pos, "lcd_driver_errors_total{op=\"open\"} %llu\n",
+           (unsigned long long)st->device_open_errors);
+    fmt_append(buf, len, pos, "lcd_driver_errors_total{op=\"write\"} %llu\n",
+           (unsigned long long)st->device_write_errors);
+    fmt_append(buf, len, pos, "lcd_driver_errors_total{op=\"keypad\"} %llu\n",
+           (unsigned long long)st->keypad_read_errors);
+
+    const msg_queue_t *q = st->messages;
+    if (q) {
+        int queued = 0;
+        for (int i = 0; i < MSG_MAX; i++) {
+            queued += q->msgs[i].id != 0;
+        }
+        header(buf, len, pos, "lcd_messages_queued", "gauge", "Posted messages waiting or shown");
+        fmt_append(buf, len, pos, "lcd_messages_queued %d\n", queued);
+        header(buf, len, pos, "lcd_messages_total", "counter", "Posted messages by outcome");
+        fmt_append(buf, len, pos, "lcd_messages_total{result=\"posted\"} %lu\n", q->posted);
+        fmt_append(buf, len, pos, "lcd_messages_total{result=\"coalesced\"} %lu\n", q->coalesced);
+        fmt_append(buf, len, pos, "lcd_messages_total{result=\"dropped\"} %lu\n", q->dropped);
+        fmt_append(buf, len, pos, "lcd_messages_total{result=\"expired\"} %lu\n", q->expired);
+        header(buf, len, pos, "lcd_message_frames_deferred_total", "counter",
+               "Message updates held back by msg_max_fps");
+        fmt_append(buf, len, pos, "lcd_message_frames_deferred_total %llu\n",
+               (unsigned long long)st->msg_frames_deferred);
+    }
+
+    if (st->alerts && r->cfg->nalerts > 0) {
+        char name[2 * sizeof(r->cfg->alerts[0].name)];
+        header(buf, len, pos, "lcd_alert_active", "gauge", "Threshold alert raised (1) or not (0)");
+        for (int i = 0; i < r->cfg->nalerts; i++) {
+            fmt_append(buf, len, pos, "lcd_alert_active{alert=\"%s\"} %d\n",
+                   label(r->cfg->alerts[i].name, name, sizeof(name)), st->alerts[i].active);
+        }
+        header(buf, len, pos, "lcd_alerts_raised_total", "counter", "Times each alert was raised");
+        for (int i = 0; i < r->cfg->nalerts; i++) {
+            fmt_append(buf, len, pos, "lcd_alerts_raised_total{alert=\"%s\"} %lu\n",
+                   label(r->cfg->alerts[i].name, name, sizeof(name)), st->alerts[i].raised);
+        }
+    }
+
+    header(buf, len, pos, "lcd_button_latency_seconds", "histogram",
+           "Keypad poll wakeup to frame written, button-triggered updates");
+    histogram(buf, len, pos, "lcd_button_latency_seconds", &trace->stage[LAT_TOTAL]);
+    header(buf, len, pos, "lcd_button_latency_stage_seconds", "summary",
+           "Button-triggered updates by stage");
+    for (int s = 0; s < LAT_TOTAL; s++) {
+        const lat_hist_t *h = &trace->stage[s];
+        fmt_append(buf, len, pos, "lcd_button_latency_stage_seconds_sum{stage=\"%s\"} %.9f\n",
+               lat_stage_name(s), h->sum_ns / 1e9);
+        fmt_append(buf, len, pos, "lcd_button_latency_stage_seconds_count{stage=\"%s\"} %llu\n",
+               lat_stage_name(s), (unsigned long long)h->count);
+    }
+    header(buf, len, pos, "lcd_button_latency_slo_misses_total", "counter",
+           "Button-triggered updates slower than latency_slo_ms");
+    fmt_append(buf, len, pos, "lcd_button_latency_slo_misses_total %llu\n",
+           (unsigned long long)trace->slo_misses);
+}
+
+size_t prom_format(char *buf, size_t len, const lcd_render_t *r,
+                   const prom_daemon_stats_t *st, const lat_trace_t *trace) {
+    size_t pos = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    format_vitals(buf, len, &pos, r);
+    format_net(buf, len, &pos);
+    format_daemon(buf, len, &pos, r, st, trace);
+    return pos;
+}
+
+int prom_write_textfile(const char *dir, const char *buf, size_t len) {
+    char path[256], tmp[256];
+
+    if (snprintf(path, sizeof(path), "%s/%s", dir, PROM_TEXTFILE_NAME) >= (int)sizeof(path) ||
+        snprintf(tmp, sizeof(tmp), "%s/.%s.tmp", dir, PROM_TEXTFILE_NAME) >= (int)sizeof(tmp)) {
+        return -1;
+    }
+    // node_exporter only reads *.prom, so the temp file is never collected
+    int fd = open(tmp, O_CREAT | O_TRUNC | O_WRONLY | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    // The unit's UMask=0077 would leave it unreadable to node_exporter
+    int mode_ok = fchmod(fd, 0644) == 0;
+    ssize_t n = write(fd, buf, len);
+    if (close(fd) != 0 || !mode_ok || n != (ssize_t)len || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef PROM_EXPORT_H
+#define PROM_EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "keypad.h"
+#include "latency.h"
+#include "lcd_render.h"
+#include "msgqueue.h"
+
+// Prometheus exposition of lcd_button_daemon: the vitals from the metrics
+// registry (cached values, re-sampled only once their interval passed, so
+// the export shares samples with the panel), counters and rates of the
+// physical NICs as the collector worker last sampled them, and the daemon's
+// own counters and histograms. Formatting reads no files.
+//
+// The daemon writes it to a node_exporter textfile-collector directory
+// (temp file + rename, so the collector never reads half a file) and
+// serves it on its query socket.
+
+#define PROM_TEXTFILE_NAME  "lcd_vitals.prom"
+
+// Daemon counters that live outside the renderer
+typedef struct {
+    uint64_t keypad_events[KEYPAD_EV_COUNT];
+    uint64_t device_open_errors;
+    uint64_t device_write_errors;    // failed frames
+    uint64_t keypad_read_errors;
+    lat_hist_t render;               // lcd_render_frame() duration
+    const msg_queue_t *messages;     // posted messages, NULL if none
+    uint64_t msg_frames_deferred;    // message updates held back by msg_max_fps
+    const alert_state_t *alerts;     // per rule of r->cfg, NULL if not evaluated
+} prom_daemon_stats_t;
+
+// Format everything. Returns the length written (truncated to len - 1).
+size_t prom_format(char *buf, size_t len, const lcd_render_t *r,
+                   const prom_daemon_stats_t *st, const lat_trace_t *trace);
+
+// Atomically replace dir/PROM_TEXTFILE_NAME. Returns 0 or -1 (errno set).
+int prom_write_textfile(const char *dir, const char *buf, size_t len);
+
+#endif // PROM_EXPORT_H
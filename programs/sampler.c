@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "sampler.h"
+
+int sample_set_path(sample_src_t *src, const char *fmt, ...) {
+    char path[SAMPLE_PATH_MAX];
+    va_list ap;
+    int written;
+
+    va_start(ap, fmt);
+    written = vsnprintf(path, sizeof(path), fmt, ap);
+    va_end(ap);
+    if (written < 0 || (size_t)written >= sizeof(path)) {
+        return -1;  // Truncated, refuse rather than read the wrong node
+    }
+
+    if (strcmp(path, src->path) != 0) {
+        sample_close(src);
+        memcpy(src->path, path, (size_t)written + 1);
+    }
+    return 0;
+}
+
+static int sample_open(sample_src_t *src) {
+    if (src->path[0] == '\0') {
+        return -1;
+    }
+    src->fd = open(src->path, O_RDONLY | O_CLOEXEC);
+    return src->fd;
+}
+
+ssize_t sample_read(sample_src_t *src, char *buf, size_t len) {
+    ssize_t n;
+
+    if (len == 0) {
+        return -1;
+    }
+    if (src->fd < 0 && sample_open(src) < 0) {
+        return -1;
+    }
+
+    n = pread(src->fd, buf, len - 1, 0);
+    if (n < 0) {
+        // The node was removed (and maybe re-created) under us: a stale
+        // sysfs handle returns ENODEV. Reopen once and retry.
+        sample_close(src);
+        if (sample_open(src) < 0) {
+            return -1;
+        }
+        n = pread(src->fd, buf, len - 1, 0);
+        if (n < 0) {
+            sample_close(src);
+            return -1;
+        }
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+int sample_read_long(sample_src_t *src, long *val) {
+    char buf[32];
+    char *endptr;
+
+    if (sample_read(src, buf, sizeof(buf)) <= 0) {
+        return -1;
+    }
+    errno = 0;
+    *val = strtol(buf, &endptr, 10);
+    if (errno == ERANGE || endptr == buf) {
+        return -1;
+    }
+    return 0;
+}
+
+int sample_read_ulong(sample_src_t *src, unsigned long *val) {
+    char buf[32];
+    char *endptr;
+
+    if (sample_read(src, buf, sizeof(buf)) <= 0) {
+        return -1;
+    }
+    errno = 0;
+    *val = strtoul(buf, &endptr, 10);
+    if (errno == ERANGE || endptr == buf) {
+        return -1;
+    }
+    return 0;
+}
+
+void sample_close(sample_src_t *src) {
+    if (src->fd >= 0) {
+        close(src->fd);
+        src->fd = -1;
+    }
+}
+
+int sample_field_ulong(const char *buf, const char *key, unsigned long *val) {
+    size_t key_len = strlen(key);
+    const char *p = buf;
+
+    while (p && *p) {
+        if (strncmp(p, key, key_len) == 0) {
+            *val = strtoul(p + key_len, NULL, 10);
+            return 0;
+        }
+        p = strchr(p, '\n');
+        if (p) {
+            p++;
+        }
+    }
+    return -1;
+}
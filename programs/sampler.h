@@ -0,0 +1,42 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Persistent handles for /proc and /sys sources.
+//
+// Each source is opened once and re-read with pread(fd, buf, n, 0) into a
+// caller-supplied (stack) buffer, so a sample costs one syscall instead of
+// open/read/close plus a stdio buffer. If the node goes away (e.g. a NIC is
+// unplugged, so its sysfs attributes return ENODEV) the handle is dropped and
+// reopened on a later read once the node is back.
+
+#define SAMPLE_PATH_MAX 128
+
+typedef struct {
+    char path[SAMPLE_PATH_MAX];
+    int fd;                      // -1 while closed
+} sample_src_t;
+
+#define SAMPLE_SRC_INIT(p) { p, -1 }
+
+// Point a source at a (new) path; closes the old handle if the path changed
+int sample_set_path(sample_src_t *src, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Read the whole node into buf (NUL terminated, at most len - 1 bytes).
+// Returns bytes read, or -1 if the source is unavailable.
+ssize_t sample_read(sample_src_t *src, char *buf, size_t len);
+
+// Read a node holding a single integer (sysfs style)
+int sample_read_long(sample_src_t *src, long *val);
+int sample_read_ulong(sample_src_t *src, unsigned long *val);
+
+void sample_close(sample_src_t *src);
+
+// Find "key" at the start of a line in a /proc/meminfo style buffer and parse
+// the number after it. Returns 0 on success, -1 if the key is missing.
+int sample_field_ulong(const char *buf, const char *key, unsigned long *val);
+
+#endif // SAMPLER_H
@@ -0,0 +1,571 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "screen_config.h"
+#include "mounts.h"
+
+#define CONFIG_FILE_MAX  16384
+#define TEXT_MAX         64
+
+// Settings every config starts from, so a file only needs the ones it
+// changes. This is the only place their default values are written down.
+static const char default_settings_text[] =
+    "model = Lanner NCA-2510A\n"
+    "poll_ms = 500\n"
+    "poll_fast_ms = 20\n"
+    "poll_active = 3\n"
+    "refresh_ms = 1000\n"
+    "line2_dwell = 5\n"
+    "latency_slo_ms = 100\n"
+    "export_dir = /var/lib/node_exporter/textfile_collector\n"
+    "export_interval = 15\n"
+    "key_debounce_ms = 30\n"
+    "key_long_ms = 1000\n"
+    "key_repeat_delay_ms = 600\n"
+    "key_repeat_ms = 200\n"
+    "msg_max_fps = 2\n"
+    "alert_blink_ms = 500\n"
+    "disk_rotate = 3\n"
+    "disk_top = 3\n";
+
+// Screens and alerts used when there is no config file (the sample
+// config/lcd_vitals.conf starts out with the same)
+static const char default_screens_text[] =
+    "[alert cpu_hot]\n"
+    "metric = cpu_temp\n"
+    "above = 85\n"
+    "for = 5\n"
+    "clear = 80\n"
+    "hold = 30\n"
+    "screen = system\n"
+    "blink = yes\n"
+    "\n"
+    "[alert disk_full]\n"
+    "metric = disk_used\n"
+    "above = 95\n"
+    "clear = 93\n"
+    "screen = system\n"
+    "\n"
+    "[alert swap_full]\n"
+    "metric = swap_used\n"
+    "above = 90\n"
+    "for = 10\n"
+    "clear = 80\n"
+    "screen = processes\n"
+    "\n"
+    "[screen load]\n"
+    "dwell = 10\n"
+    "text = L:{load1} M:{mem_used}% {time}\n"
+    "text = L:{load1} M:N/A {time}\n"
+    "text = L:N/A M:{mem_used}% {time}\n"
+    "text = L:N/A M:N/A {time}\n"
+    "\n"
+    "[screen system]\n"
+    "dwell = 10\n"
+    "text = CPU:{cpu_temp}C D:{disk_used}% /{uptime}\n"
+    "text = CPU:{cpu_temp}C Up:{uptime}\n"
+    "text = Disk:{disk_used}% Up:{uptime}\n"
+    "text = Uptime: {uptime}\n"
+    "\n"
+    "[screen sensors]\n"
+    "dwell = 10\n"
+    "text = CPU {cpu_temp}C Fan {fan_rpm}rpm\n"
+    "text = CPU {cpu_temp}C\n"
+    "\n"
+    "[screen disks]\n"
+    "dwell = 10\n"
+    "text = Disk {disk}\n"
+    "\n"
+    "[screen network]\n"
+    "dwell = 10\n"
+    "text = {net}\n"
+    "\n"
+    "[screen processes]\n"
+    "dwell = 10\n"
+    "text = Up:{uptime} P:{procs} S:{swap_used}%\n"
+    "text = Up:{uptime} P:{procs}\n"
+    "text = Up:{uptime} S:{swap_used}%\n"
+    "text = Up:{uptime}\n";
+
+static const char *var_names[SCREEN_VAR_COUNT] = {
+    [SCREEN_VAR_LOAD1]     = "load1",
+    [SCREEN_VAR_MEM_USED]  = "mem_used",
+    [SCREEN_VAR_CPU_TEMP]  = "cpu_temp",
+    [SCREEN_VAR_DISK_USED] = "disk_used",
+    [SCREEN_VAR_DISK]      = "disk",
+    [SCREEN_VAR_UPTIME]    = "uptime",
+    [SCREEN_VAR_PROCS]     = "procs",
+    [SCREEN_VAR_SWAP_USED] = "swap_used",
+    [SCREEN_VAR_FAN_RPM]   = "fan_rpm",
+    [SCREEN_VAR_TIME]      = "time",
+    [SCREEN_VAR_NET]       = "net",
+    [SCREEN_VAR_HOSTNAME]  = "hostname",
+    [SCREEN_VAR_MODEL]     = "model",
+};
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+static int parse_int(const char *value, int min, int max, int *out) {
+    char *endptr;
+    long v = strtol(value, &endptr, 10);
+    if (endptr == value || *endptr != '\0' || v < min || v > max) {
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+static int parse_bool(const char *value, int *out) {
+    if (strcmp(value, "yes") == 0 || strcmp(value, "1") == 0) {
+        *out = 1;
+    } else if (strcmp(value, "no") == 0 || strcmp(value, "0") == 0) {
+        *out = 0;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_align(const char *value, fmt_align_t *out) {
+    if (strcmp(value, "left") == 0) {
+        *out = FMT_LEFT;
+    } else if (strcmp(value, "right") == 0) {
+        *out = FMT_RIGHT;
+    } else if (strcmp(value, "center") == 0 || strcmp(value, "centre") == 0) {
+        *out = FMT_CENTER;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_alert_key(alert_rule_t *a, const char *key, const char *value,
+                           char *msg, size_t msglen) {
+    if (strcmp(key, "metric") == 0) {
+        int id = metric_find(value);
+        if (id < 0 || id == METRIC_HOSTNAME || id == METRIC_NET) {
+            snprintf(msg, msglen, "unknown metric '%s'", value);
+            return -1;
+        }
+        a->metric = id;
+        return 0;
+    } else if (strcmp(key, "above") == 0 || strcmp(key, "below") == 0) {
+        a->op = key[0] == 'a' ? ALERT_ABOVE : ALERT_BELOW;
+        return parse_int(value, -1000000, 1000000, &a->threshold);
+    } else if (strcmp(key, "clear") == 0) {
+        return parse_int(value, -1000000, 1000000, &a->clear);
+    } else if (strcmp(key, "for") == 0) {
+        return parse_int(value, 0, 3600, &a->for_s);
+    } else if (strcmp(key, "hold") == 0) {
+        return parse_int(value, 0, 86400, &a->hold_s);
+    } else if (strcmp(key, "screen") == 0) {
+        snprintf(a->screen_name, sizeof(a->screen_name), "%s", value);
+        return 0;
+    } else if (strcmp(key, "blink") == 0) {
+        return parse_bool(value, &a->blink);
+    }
+    snprintf(msg, msglen, "unknown alert setting '%s'", key);
+    return -1;
+}
+
+// Fill in defaults and resolve the screen once the whole file is read
+static int finish_alert(screen_config_t *cfg, alert_rule_t *a, char *err, size_t errlen) {
+    if (a->metric == METRIC_COUNT || a->threshold == INT_MIN) {
+        snprintf(err, errlen, "alert %s needs metric and above or below", a->name);
+        return -1;
+    }
+    if (a->clear == INT_MIN) {
+        a->clear = a->threshold;
+    }
+    if (a->op == ALERT_ABOVE ? a->clear > a->threshold : a->clear < a->threshold) {
+        snprintf(err, errlen, "alert %s: clear must be on the other side of the threshold", a->name);
+        return -1;
+    }
+    a->screen = -1;
+    if (a->screen_name[0] != '\0') {
+        for (int i = 0; i < cfg->nscreens; i++) {
+            if (strcmp(cfg->screens[i].name, a->screen_name) == 0) {
+                a->screen = i;
+            }
+        }
+        if (a->screen < 0) {
+            snprintf(err, errlen, "alert %s: no screen '%s'", a->name, a->screen_name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int emit_op(screen_config_t *cfg, uint8_t op, uint8_t len, uint16_t arg) {
+    if (cfg->nops >= SCREEN_MAX_OPS) {
+        return -1;
+    }
+    screen_op_t *o = &cfg->ops[cfg->nops++];
+    o->op = op;
+    o->len = len;
+    o->arg = arg;
+    return 0;
+}
+
+// Append a literal byte, growing the previous literal op if it ends at the
+// pool tail
+static int emit_char(screen_config_t *cfg, screen_alt_t *alt, char c) {
+    screen_op_t *last = alt->nops ? &cfg->ops[cfg->nops - 1] : NULL;
+
+    if (cfg->pool_len >= SCREEN_POOL_SIZE) {
+        return -1;
+    }
+    if (last && last->op == SCREEN_OP_LIT && last->arg + last->len == cfg->pool_len && last->len < 255) {
+        last->len++;
+    } else {
+        if (emit_op(cfg, SCREEN_OP_LIT, 1, cfg->pool_len) != 0) {
+            return -1;
+        }
+        alt->nops++;
+    }
+    cfg->pool[cfg->pool_len++] = c;
+    return 0;
+}
+
+static int compile_text(screen_config_t *cfg, screen_t *scr, const char *text, char *err, size_t errlen) {
+    if (scr->nalts >= SCREEN_MAX_ALTS) {
+        snprintf(err, errlen, "more than %d text alternatives", SCREEN_MAX_ALTS);
+        return -1;
+    }
+    if (strlen(text) > TEXT_MAX) {
+        snprintf(err, errlen, "text longer than %d characters", TEXT_MAX);
+        return -1;
+    }
+
+    screen_alt_t *alt = &scr->alts[scr->nalts];
+    memset(alt, 0, sizeof(*alt));
+    alt->first_op = cfg->nops;
+
+    for (const char *p = text; *p; p++) {
+        if (p[0] == '{' && p[1] == '{') {
+            p++;
+        } else if (p[0] == '{') {
+            const char *end = strchr(p, '}');
+            int var;
+            if (!end) {
+                snprintf(err, errlen, "unterminated '{'");
+                return -1;
+            }
+            for (var = 0; var < SCREEN_VAR_COUNT; var++) {
+                size_t n = strlen(var_names[var]);
+                if ((size_t)(end - p - 1) == n && strncmp(p + 1, var_names[var], n) == 0) {
+                    break;
+                }
+            }
+            if (var == SCREEN_VAR_COUNT) {
+                snprintf(err, errlen, "unknown metric '%.*s'", (int)(end - p - 1), p + 1);
+                return -1;
+            }
+            if (emit_op(cfg, SCREEN_OP_VAR, 0, var) != 0) {
+                snprintf(err, errlen, "too many template operations");
+                return -1;
+            }
+            alt->nops++;
+            alt->needs |= 1u << var;
+            p = end;
+            continue;
+        }
+        if (emit_char(cfg, alt, *p) != 0) {
+            snprintf(err, errlen, "too much template text");
+            return -1;
+        }
+    }
+    scr->nalts++;
+    return 0;
+}
+
+// Apply the lines of text to cfg on top of what it already holds
+static int parse_lines(screen_config_t *cfg, const char *text, char *err, size_t errlen) {
+    char line[256];
+    char msg[128];
+    int lineno = 0;
+    screen_t *scr = NULL;
+    alert_rule_t *alert = NULL;
+
+    const char *p = text;
+    while (*p) {
+        const char *nl = strchr(p, '\n');
+        size_t len = nl ? (size_t)(nl - p) : strlen(p);
+        lineno++;
+        if (len >= sizeof(line)) {
+            snprintf(err, errlen, "line %d: too long", lineno);
+            return -1;
+        }
+        memcpy(line, p, len);
+        line[len] = '\0';
+        p += len + (nl ? 1 : 0);
+
+        char *s = trim(line);
+        if (*s == '\0' || *s == '#') {
+            continue;
+        }
+
+        if (*s == '[') {
+            char *end = strchr(s, ']');
+            if (end && strncmp(s, "[alert", 6) == 0) {
+                if (cfg->nalerts >= ALERT_MAX) {
+                    snprintf(err, errlen, "line %d: more than %d alerts", lineno, ALERT_MAX);
+                    return -1;
+                }
+                *end = '\0';
+                scr = NULL;
+                alert = &cfg->alerts[cfg->nalerts++];
+                alert->metric = METRIC_COUNT;
+                alert->threshold = INT_MIN;
+                alert->clear = INT_MIN;
+                alert->hold_s = 10;
+                snprintf(alert->name, sizeof(alert->name), "%s", trim(s + 6));
+                continue;
+            }
+            if (!end || strncmp(s, "[screen", 7) != 0) {
+                snprintf(err, errlen, "line %d: expected [screen <name>] or [alert <name>]", lineno);
+                return -1;
+            }
+            alert = NULL;
+            if (cfg->nscreens >= SCREEN_MAX) {
+                snprintf(err, errlen, "line %d: more than %d screens", lineno, SCREEN_MAX);
+                return -1;
+            }
+            *end = '\0';
+            scr = &cfg->screens[cfg->nscreens++];
+            scr->dwell_s = 10;
+            scr->align = FMT_LEFT;
+            snprintf(scr->name, sizeof(scr->name), "%s", trim(s + 7));
+            continue;
+        }
+
+        char *eq = strchr(s, '=');
+        if (!eq) {
+            snprintf(err, errlen, "line %d: expected key = value", lineno);
+            return -1;
+        }
+        *eq = '\0';
+        char *key = trim(s);
+        char *value = trim(eq + 1);
+        int bad = 0;
+
+        msg[0] = '\0';
+        if (alert) {
+            bad = parse_alert_key(alert, key, value, msg, sizeof(msg));
+        } else if (!scr) {
+            if (strcmp(key, "model") == 0) {
+                snprintf(cfg->model, sizeof(cfg->model), "%s", value);
+            } else if (strcmp(key, "poll_ms") == 0) {
+                bad = parse_int(value, 20, 2000, &cfg->poll_ms);
+            } else if (strcmp(key, "poll_fast_ms") == 0) {
+                bad = parse_int(value, 10, 2000, &cfg->poll_fast_ms);
+            } else if (strcmp(key, "poll_active") == 0) {
+                bad = parse_int(value, 0, 60, &cfg->poll_active_s);
+            } else if (strcmp(key, "refresh_ms") == 0) {
+                bad = parse_int(value, 100, 60000, &cfg->refresh_ms);
+            } else if (strcmp(key, "line2_dwell") == 0) {
+                bad = parse_int(value, 1, 3600, &cfg->line2_dwell_s);
+            } else if (strcmp(key, "latency_slo_ms") == 0) {
+                bad = parse_int(value, 0, 10000, &cfg->latency_slo_ms);
+            } else if (strcmp(key, "export_dir") == 0) {
+                if (value[0] != '/' || strlen(value) >= sizeof(cfg->export_dir)) {
+                    snprintf(msg, sizeof(msg), "export_dir must be an absolute path");
+                    bad = -1;
+                } else {
+                    snprintf(cfg->export_dir, sizeof(cfg->export_dir), "%s", value);
+                }
+            } else if (strcmp(key, "export_interval") == 0) {
+                bad = parse_int(value, 0, 3600, &cfg->export_interval_s);
+            } else if (strcmp(key, "key_debounce_ms") == 0) {
+                bad = parse_int(value, 0, 500, &cfg->keypad.debounce_ms);
+            } else if (strcmp(key, "key_long_ms") == 0) {
+                bad = parse_int(value, 0, 10000, &cfg->keypad.long_ms);
+            } else if (strcmp(key, "key_repeat_delay_ms") == 0) {
+                bad = parse_int(value, 0, 10000, &cfg->keypad.repeat_delay_ms);
+            } else if (strcmp(key, "key_repeat_ms") == 0) {
+                bad = parse_int(value, 20, 5000, &cfg->keypad.repeat_ms);
+            } else if (strcmp(key, "msg_max_fps") == 0) {
+                bad = parse_int(value, 1, 20, &cfg->msg_max_fps);
+            } else if (strcmp(key, "alert_blink_ms") == 0) {
+                bad = parse_int(value, 100, 5000, &cfg->blink_ms);
+            } else if (strcmp(key, "disk_rotate") == 0) {
+                bad = parse_int(value, 1, 60, &cfg->disk_rotate_s);
+            } else if (strcmp(key, "disk_top") == 0) {
+                bad = parse_int(value, 1, MOUNTS_MAX, &cfg->disk_top);
+            } else {
+                snprintf(msg, sizeof(msg), "unknown setting '%s'", key);
+                bad = -1;
+            }
+        } else {
+            if (strcmp(key, "dwell") == 0) {
+                bad = parse_int(value, 1, 3600, &scr->dwell_s);
+            } else if (strcmp(key, "align") == 0) {
+                bad = parse_align(value, &scr->align);
+            } else if (strcmp(key, "text") == 0) {
+                bad = compile_text(cfg, scr, value, msg, sizeof(msg));
+            } else {
+                snprintf(msg, sizeof(msg), "unknown screen setting '%s'", key);
+                bad = -1;
+            }
+        }
+        if (bad) {
+            snprintf(err, errlen, "line %d: %s", lineno, msg[0] ? msg : "value out of range");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int screen_config_parse(screen_config_t *out, const char *text, char *err, size_t errlen) {
+    static screen_config_t cfg;  // ~3KB, keep it off the stack
+
+    memset(&cfg, 0, sizeof(cfg));
+    if (parse_lines(&cfg, default_settings_text, err, errlen) != 0 ||
+        parse_lines(&cfg, text, err, errlen) != 0) {
+        return -1;
+    }
+
+    if (cfg.nscreens == 0) {
+        snprintf(err, errlen, "no [screen] defined");
+        return -1;
+    }
+    for (int i = 0; i < cfg.nscreens; i++) {
+        if (cfg.screens[i].nalts == 0) {
+            snprintf(err, errlen, "screen %d (%s) has no text", i + 1, cfg.screens[i].name);
+            return -1;
+        }
+    }
+    for (int i = 0; i < cfg.nalerts; i++) {
+        if (finish_alert(&cfg, &cfg.alerts[i], err, errlen) != 0) {
+            return -1;
+        }
+    }
+
+    memcpy(out, &cfg, sizeof(cfg));
+    return 0;
+}
+
+int screen_config_load(screen_config_t *cfg, const char *path, char *err, size_t errlen) {
+    static char text[CONFIG_FILE_MAX];
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        snprintf(err, errlen, "%s: cannot open", path);
+        return -1;
+    }
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    int truncated = !feof(f);
+    fclose(f);
+    if (truncated) {
+        snprintf(err, errlen, "%s: larger than %d bytes", path, CONFIG_FILE_MAX - 1);
+        return -1;
+    }
+    text[n] = '\0';
+
+    char msg[160];
+    if (screen_config_parse(cfg, text, msg, sizeof(msg)) != 0) {
+        snprintf(err, errlen, "%s: %s", path, msg);
+        return -1;
+    }
+    return 0;
+}
+
+const screen_config_t *screen_config_default(void) {
+    static screen_config_t cfg;
+    static int compiled = 0;
+
+    if (!compiled) {
+        char err[8];
+        screen_config_parse(&cfg, default_screens_text, err, sizeof(err));
+        compiled = 1;
+    }
+    return &cfg;
+}
+
+// Copy src into the text buffer at pos as part of field f; returns the
+// bytes copied (fewer once the buffer is full)
+static int append(fmt_field_t *f, char *text, int pos, int size, const char *src, int len) {
+    if (len > size - pos) {
+        len = size - pos;
+    }
+    memcpy(text + pos, src, len);
+    f->len += len;
+    return len;
+}
+
+void screen_render(const screen_config_t *cfg, int n, screen_eval_fn eval, void *ctx, char *out) {
+    char vals[SCREEN_VAR_COUNT][64];
+    int state[SCREEN_VAR_COUNT] = {0};  // 0 not evaluated, 1 available, 2 not
+    const screen_t *scr = &cfg->screens[n];
+    const screen_alt_t *alt = &scr->alts[scr->nalts - 1];
+    char text[512];
+    fmt_field_t fields[FMT_MAX_FIELDS];
+    int nfields = 1, pos = 0, has_var = 0;
+
+    // First alternative whose metrics are all there, else the last one
+    for (int a = 0; a < scr->nalts - 1; a++) {
+        uint32_t needs = scr->alts[a].needs;
+        int ok = 1;
+        for (int v = 0; ok && v < SCREEN_VAR_COUNT; v++) {
+            if (!(needs & (1u << v))) {
+                continue;
+            }
+            if (state[v] == 0) {
+                state[v] = eval(v, vals[v], sizeof(vals[v]), ctx) ? 1 : 2;
+            }
+            ok = state[v] == 1;
+        }
+        if (ok) {
+            alt = &scr->alts[a];
+            break;
+        }
+    }
+
+    // Split into fields, each value with the text before it and its unit
+    // (up to the next space); earlier fields rank higher
+    fields[0].text = text;
+    fields[0].len = 0;
+    fields[0].prio = FMT_MAX_FIELDS;
+    for (int i = 0; i < alt->nops; i++) {
+        const screen_op_t *op = &cfg->ops[alt->first_op + i];
+        const char *src;
+        int len;
+
+        if (op->op == SCREEN_OP_LIT) {
+            src = cfg->pool + op->arg;
+            len = op->len;
+            const char *sp = has_var ? memchr(src, ' ', len) : NULL;
+            if (sp && nfields < FMT_MAX_FIELDS) {
+                pos += append(&fields[nfields - 1], text, pos, sizeof(text), src, (int)(sp - src));
+                len -= (int)(sp - src);
+                src = sp;
+                fields[nfields].text = text + pos;
+                fields[nfields].len = 0;
+                fields[nfields].prio = FMT_MAX_FIELDS - nfields;
+                nfields++;
+                has_var = 0;
+            }
+        } else {
+            if (state[op->arg] == 0) {
+                state[op->arg] = eval(op->arg, vals[op->arg], sizeof(vals[op->arg]), ctx) ? 1 : 2;
+            }
+            src = state[op->arg] == 1 ? vals[op->arg] : "N/A";
+            len = strlen(src);
+            has_var = 1;
+        }
+        pos += append(&fields[nfields - 1], text, pos, sizeof(text), src, len);
+    }
+    fmt_line(out, SCREEN_COLS, fields, nfields, scr->align);
+}
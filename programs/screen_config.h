@@ -0,0 +1,133 @@
+#ifndef SCREEN_CONFIG_H
+#define SCREEN_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "keypad.h"
+#include "alerts.h"
+#include "fmt.h"
+
+// Declarative screen configuration (/etc/lcd_vitals.conf).
+//
+//   model = Lanner NCA-2510A
+//   poll_ms = 500
+//   poll_fast_ms = 20
+//   refresh_ms = 1000
+//   line2_dwell = 5
+//   latency_slo_ms = 100
+//   export_interval = 15
+//   key_repeat_delay_ms = 600
+//
+//   [screen load]
+//   dwell = 10
+//   text = L:{load1} M:{mem_used}% {time}
+//
+// [alert] sections declare threshold alerts (alerts.h).
+//
+// Each [screen] is one line-1 view, shown for `dwell` seconds before the
+// auto-cycle moves on. A screen may have several `text` alternatives: the
+// first one whose metrics are all available is used, the last one always
+// (an unavailable metric then prints as N/A). "{{" is a literal brace.
+//
+// A line too long for the panel loses whole values from the right rather
+// than being cut mid-number: each variable is a field together with the
+// text before it and the unit text up to the next space ("L:{load1}",
+// " M:{mem_used}%"), the first field ranking highest. `align` places the
+// line left (default), right or center.
+//
+// Templates are compiled once at load into a flat list of literal/variable
+// ops, so rendering a frame is a single pass with no format parsing.
+
+#define LCD_CONFIG_FILE     "/etc/lcd_vitals.conf"
+
+#define SCREEN_MAX          16
+#define SCREEN_MAX_ALTS     4
+#define SCREEN_MAX_OPS      256  // all screens together
+#define SCREEN_POOL_SIZE    1024 // literal text, all screens together
+#define SCREEN_COLS         20   // visible columns per line
+
+typedef enum {
+    SCREEN_VAR_LOAD1,
+    SCREEN_VAR_MEM_USED,
+    SCREEN_VAR_CPU_TEMP,
+    SCREEN_VAR_DISK_USED,
+    SCREEN_VAR_DISK,
+    SCREEN_VAR_UPTIME,
+    SCREEN_VAR_PROCS,
+    SCREEN_VAR_SWAP_USED,
+    SCREEN_VAR_FAN_RPM,
+    SCREEN_VAR_TIME,
+    SCREEN_VAR_NET,
+    SCREEN_VAR_HOSTNAME,
+    SCREEN_VAR_MODEL,
+    SCREEN_VAR_COUNT
+} screen_var_t;
+
+enum {
+    SCREEN_OP_LIT,               // arg = offset into pool, len bytes
+    SCREEN_OP_VAR,               // arg = screen_var_t
+};
+
+typedef struct {
+    uint8_t op;
+    uint8_t len;
+    uint16_t arg;
+} screen_op_t;
+
+typedef struct {
+    uint16_t first_op;
+    uint16_t nops;
+    uint32_t needs;              // bit per screen_var_t used
+} screen_alt_t;
+
+typedef struct {
+    char name[16];
+    int dwell_s;
+    fmt_align_t align;
+    int nalts;
+    screen_alt_t alts[SCREEN_MAX_ALTS];
+} screen_t;
+
+typedef struct {
+    int nscreens;
+    screen_t screens[SCREEN_MAX];
+    int nops;
+    screen_op_t ops[SCREEN_MAX_OPS];
+    int pool_len;
+    char pool[SCREEN_POOL_SIZE];
+
+    char model[SCREEN_COLS + 1];
+    int poll_ms;                 // keypad poll interval when idle
+    int poll_fast_ms;            // ... and after key activity
+    int poll_active_s;           // how long activity keeps it fast
+    int refresh_ms;              // repaint interval when nothing else changed
+    int line2_dwell_s;
+    int latency_slo_ms;          // button-to-pixel objective, 0 = none
+    keypad_timing_t keypad;      // debounce, long-press and repeat timings
+    char export_dir[128];        // node_exporter textfile directory
+    int export_interval_s;       // how often to write it, 0 = never
+    int msg_max_fps;             // frames/s posted messages may cause
+    int nalerts;
+    alert_rule_t alerts[ALERT_MAX];
+    int blink_ms;                // backlight blink half-period of alerts
+    int disk_rotate_s;           // {disk} moves to the next filesystem
+    int disk_top;                // ... of this many fullest ones
+} screen_config_t;
+
+// Built-in configuration (the screens lcd_vitals always had)
+const screen_config_t *screen_config_default(void);
+
+// Parse config text / a config file. On error returns -1 with a message
+// (including the line number) in err, and leaves *cfg untouched.
+int screen_config_parse(screen_config_t *cfg, const char *text, char *err, size_t errlen);
+int screen_config_load(screen_config_t *cfg, const char *path, char *err, size_t errlen);
+
+// Evaluate one variable into buf; returns 1 if the value is available,
+// 0 if not (buf is then ignored)
+typedef int (*screen_eval_fn)(screen_var_t var, char *buf, size_t buflen, void *ctx);
+
+// Render screen n into out: SCREEN_COLS columns, space padded, no NUL.
+// Variables are only evaluated when an alternative uses them, once each.
+void screen_render(const screen_config_t *cfg, int n, screen_eval_fn eval, void *ctx, char *out);
+
+#endif // SCREEN_CONFIG_H